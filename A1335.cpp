@@ -25,8 +25,6 @@ int16_t&   bytes_2::in(){
 byte&      bytes_2::lsBy(byte n){
   if (n > 1) {
     n = 1;
-  } else if (n < 0) {
-    n = 0;
   }
   return data.bytes[n];
 }
@@ -34,8 +32,6 @@ byte&      bytes_2::lsBy(byte n){
 byte&      bytes_2::msBy(byte n){
   if (n > 1) {
     n = 1;
-  } else if (n < 0) {
-    n = 0;
   }
   return data.bytes[1-n];
 }
@@ -55,8 +51,6 @@ int32_t&   bytes_4::in(){
 byte&      bytes_4::lsBy(byte n){
   if (n > 3) {
     n = 3;
-  } else if (n < 0) {
-    n = 0;
   }
   return data.bytes[n];
 }
@@ -64,109 +58,48 @@ byte&      bytes_4::lsBy(byte n){
 byte&      bytes_4::msBy(byte n){
   if (n > 3) {
     n = 3;
-  } else if (n < 0) {
-    n = 0;
   }
   return data.bytes[3-n];
 }
 
-//--- Normal Write Registers ---//
-
-const byte EWA    = 0x02;   // Extended Write Address
-const byte EWD    = 0x04;   // Extended Write Data
-const byte EWCS   = 0x08;   // Extended Write Control and Status
-const byte ERA    = 0x0A;   // Extended Read Address
-const byte ERCS   = 0x0C;   // Extended Read Control and Status
-const byte ERD    = 0x0E;   // Extended Read Data
-const byte CTRL   = 0x1E;   // Device control
-const byte ANG    = 0x20;   // Current angle and related data
-const byte STA    = 0x22;   // Device status
-const byte ERR    = 0x24;   // Device error status
-const byte XERR   = 0x26;   // Extended error status
-const byte TSEN   = 0x28;   // Temperature sensor data
-const byte FIELD  = 0x2A;   // Magnetic field strength
-const byte ERM    = 0x34;   // Device error status masking
-const byte XERM   = 0x36;   // Extended error status masking
-
-//--- Extended Write Registers ---//
-
-const int16_t ORATE = 0xFFD0;  // Output Rate
-
-
-// Control bytes and their respective keycodes:
-
-//                      CTRL(0x1E) KEY(0x1F)
-//  Processor State
-const byte ipm[]    = { B10000000, 0x46     }; // Idle mode
-const byte rpm[]    = { B11000000, 0x46     }; // Run  mode
-//  Hard Reset
-const byte hre[]    = { B00100000, 0xB9     }; // Hard reset
-//  Soft Reset
-const byte sre[]    = { B00010000, 0xB9     }; // Soft reset
-//  Clear STA
-const byte csta[]   = { B00000100, 0x46     }; // Clear (STA)  registers
-//  Hard Reset
-const byte cxerr[]  = { B00000010, 0x46     }; // Clear (XERR) registers
-//  Hard Reset
-const byte cerr[]   = { B00000001, 0x46     }; // Clear (ERR)  registers
- 
-
-// Angle Register read masks
-
-//                      ANG(0x20)  ANG+1(0x21)
-// Register Identifier Code
-const byte ria[]    = { B10000000, B00000000}; // Always 0
-// Error Flag
-const byte efa[]    = { B01000000, B00000000}; // At least one error in register 0x24
-// New Flag
-const byte nfa[]    = { B00100000, B00000000}; // A new angle is in the angle register
-// Parity
-const byte par[]    = { B00010000, B00000000}; // Odd parity bit for the whole register
-// Angle
-const byte ang[]    = { B00001111, B11111111}; // Encoded angle reading (n * 360/4096 = angle in deg.)
-
-
-// Status Register read masks
-
-//                      STA(0x20)  STA+1(0x21)
-// Register Identifier Code
-const byte ris[]    = { B11110000, B00000000}; // Always 1000
-// Power-On Reset Flag
-const byte por[]    = { B00001000, B00000000}; // There was a power-on reset since last field reset
-// Soft Reset Flag
-const byte srf[]    = { B00000100, B00000000}; // There was a soft reset since last field reset
-// New Flag
-const byte nfs[]    = { B00000010, B00000000}; // A new angle is in the angle register
-// Current Error Flag
-const byte efs[]    = { B00000001, B00000000}; // At least one error in register 0x24
-// Processor Processing Status
-const byte mps[]    = { B00000000, B11110000}; // 0000 Booting; 0001 Idle or Processing angles; 1110 Self-testmode
-// Processor Phase Status
-const byte phase[]  = { B00000000, B00001111}; // 0000 Idle; 0001 Processing angles; Only in Self-test mode [0100 Built in self test; 0110 ROM checksum; 0111 CVH self test]
-
-
-// Temperature Register read masks
-
-//                      TSEN(0x28) TSEN+1(0x29)
-// Register Identifier Code
-const byte rit[]    = { B11110000, B00000000}; // Always 1111
-// Temperature
-const byte temp[]   = { B00001111, B11111111}; // Encoded temperature reading (n / 8 = temperature in K)
-
-
-// Field Strenght Register read masks
-
-//                      FIELD(0x28) FIELD+1(0x29)
-// Register Identifier Code
-const byte rif[]    = { B11110000, B00000000}; // Always 1110
-// Magnetic field strenght
-const byte field[]  = { B00001111, B11111111}; // Magnetic field strenght reading (n = field strenght in Gauss (1/10000 T))
-
-
-A1335::A1335(){
+using namespace A1335Reg;
+
+
+// Instrumentation, compiled in only with A1335_INSTRUMENTATION
+
+#if A1335_INSTRUMENTATION
+  #define A1335_TRACE_BEGIN()             uint32_t traceStart = micros()
+  #define A1335_TRACE_END(reg, error)     recordTransfer(reg, error, traceStart)
+  #define A1335_COUNT_ANGLE(status)       recordAngle(status)
+#else
+  #define A1335_TRACE_BEGIN()
+  #define A1335_TRACE_END(reg, error)
+  #define A1335_COUNT_ANGLE(status)
+#endif
+
+// Bus locking, compiled in only with A1335_RTOS. Functions that keep the bus between
+// transfers hold the lock for all of them; the lock of the transport nests.
+
+#if A1335_RTOS
+  #define A1335_LOCK()                    A1335BusLock busLock(*bus)
+#else
+  #define A1335_LOCK()
+#endif
+
+
+// Extended access timing
+
+const byte     EXT_DONE       = B00000001; // Done flag in the low byte of EWCS / ERCS
+
+
+A1335::A1335(A1335Transport& transport) : bus(&transport){
   
 }
 
+void      A1335::setTransport(A1335Transport& transport){  // moves the sensor to another bus
+  bus = &transport;
+}
+
 int16_t   A1335::getAddress(){                  // returns I2C address of the sensor
   return address;
 }
@@ -179,19 +112,53 @@ byte      A1335::getOutputRate(){               // returns the current sample ra
   return outputRate;
 }
 
-byte      A1335::start(int16_t address_){        // Initializes the sensor at the address given and fills the private variables
-  Wire.beginTransmission(address);
-  byte error = Wire.endTransmission();
+uint32_t  A1335::getSamplePeriod(){             // returns the time between two new angles
+  return uint32_t(A1335_BASE_PERIOD_US) << outputRate;
+}
+
+byte      A1335::start(int16_t address_, const A1335Settings* settings, const A1335CalTable* calibration_){  // Initializes the sensor and waits until it settled
+  byte error = begin(address_, settings, calibration_);
+  if (!error) {
+    delay(1);
+  }
+  return error;
+}
+
+byte      A1335::begin(int16_t address_, const A1335Settings* settings, const A1335CalTable* calibration_){  // Initializes the sensor at the address given and fills the private variables
+  A1335_LOCK();
+  byte error = bus->probe(address_);
   if (error) {
     processorState = 4;
     return error;
   }
+#if A1335_CALIBRATION
+  if (calibration_) {
+    setCalibration(calibration_);
+  }
+#else
+  (void)calibration_;
+#endif
   address = address_;
-  bytes_2 state(normalRead(STA));
-  bytes_4 orate(extendedRead(ORATE));
+  clearShadow();
+  faultSet   = 0;
+  faultState &= FAULT_MASKS;
+  if (faultState & FAULT_MASKS) {
+    writeErrorMasks();
+  }
+  uint16_t state = normalRead(STA);
+  uint32_t orate = 0;
+  if (settings && settings->valid() && settings->address == address) {
+    orate = settings->orate;            // warm boot, the sensor EEPROM did not change
+  } else {
+    error = extendedRead(ORATE, orate);
+  }
+  if (!error) {
+    storeShadow(ORATE, orate);          // without a copy setOutputRate() reads ORATE again before it writes
+    outputRate = ORATE_RATE::get(orate);
+  }
   
-  byte processing_status = (state.msBy(1) & mps[1]) >> 4;
-  byte processing_phase =  (state.msBy(1) & phase[1]) >> 0;
+  byte processing_status = STA_MPS::get(state);
+  byte processing_phase  = STA_PHASE::get(state);
   switch (processing_status) {
     case B00000000:
       processorState = 0;
@@ -207,136 +174,837 @@ byte      A1335::start(int16_t address_){        // Initializes the sensor at th
       processorState = 3;
       break;
   }
-  outputRate = orate.msBy(3);
-  delay(1);
   return error;
 }
 
+bool      A1335::saveSettings(A1335Settings& settings){  // fills settings for a warm boot with start()
+  A1335_LOCK();
+  settings.address = address;
+  byte error = extendedReadCached(ORATE, settings.orate);
+  settings.check = settings.checksum();
+  if (error) {
+    settings.check = ~settings.check;   // a failed read must not be trusted on the next boot
+  }
+  return !error;
+}
+
+byte      A1335Settings::checksum() const {
+  byte sum = 0xA5 ^ address;
+  for (byte i = 0; i < 4; i++){
+    sum = (sum << 1 | sum >> 7) ^ byte(orate >> (8 * i));
+  }
+  return sum;
+}
+
+bool      A1335Settings::valid() const {
+  return check == checksum();
+}
+
+#if !A1335_NO_DOUBLE
 double    A1335::readAngle(){       // returns Angle in Degrees
   return double(readAngleRaw()) * 360.0 / 4096.0;
 }
+#endif
+
+uint16_t  A1335::readAngleQ16(){    // returns the angle in 1/65536 turns
+  return A1335Fixed::angleQ16(readAngleRaw());
+}
+
+uint16_t  A1335::readAngleCentideg(){  // returns the angle in 1/100 degrees
+  return A1335Fixed::angleCentideg(readAngleRaw());
+}
+
 uint16_t  A1335::readAngleRaw(){    // returns raw angle data
-  bytes_2 angReg(normalRead(ANG));
+  A1335_LOCK();
+  uint16_t angReg;
+  if (normalRead(ANG, angReg)) {    // the failed transfer is counted as such, not as a bad angle
+    return 0;
+  }
+  A1335_COUNT_ANGLE(angleStatus(angReg));
   
-  int16_t parityCheck = angReg.in();
-  parityCheck ^= parityCheck >> 8;
-  parityCheck ^= parityCheck >> 4;
-  parityCheck ^= parityCheck >> 2;
-  parityCheck ^= parityCheck >> 1;
-  parityCheck &= 1;                 // parity Check now contains the parity of all bits in angReg
-  if(!parityCheck) {                // odd Parity in this register => a 0 means an error
+  if(!parityOk(angReg)) {           // odd Parity in this register => a 0 means an error
     return 0;
   }
+  noteAngle(angReg);
   
-  angReg.msBy(0) &= ang[0];           // mutes bits, that dont contain the angle data
-  return angReg.in();
+  return corrected(ANG_ANGLE::get(angReg));
+}
+
+A1335Result A1335::readAngleResult(){    // the raw angle and everything the same read tells about it
+  A1335_LOCK();
+  A1335Result result;
+  uint16_t angReg;
+  byte error = normalRead(ANG, angReg);
+  if (error) {
+    result.value  = 0;
+    result.status = busStatus(error);
+    return result;
+  }
+  result.status = angleStatus(angReg);
+  result.value  = (result.status & A1335_STATUS_PARITY) ? 0 : corrected(ANG_ANGLE::get(angReg));
+  A1335_COUNT_ANGLE(result.status);
+  if (!(result.status & A1335_STATUS_PARITY)) {
+    noteAngle(angReg);                  // the EF bit of a corrupted register means nothing
+  }
+  return result;
+}
+
+A1335Result A1335::readTempResult(){
+  return readResult(TSEN, TSEN_TEMP::get);
+}
+
+A1335Result A1335::readFieldResult(){
+  return readResult(FIELD, FIELD_FIELD::get);
+}
+
+A1335Result A1335::readResult(byte reg, uint16_t (*get)(uint16_t)){  // reads reg and decodes it with get
+  A1335Result result;
+  uint16_t data;
+  byte error = normalRead(reg, data);
+  result.status = busStatus(error);
+  result.value  = error ? 0 : get(data);
+  return result;
+}
+
+byte      A1335::angleStatus(uint16_t angReg){  // flags of the angle register
+  return (ANG_NEW::test(angReg) ? A1335_STATUS_NEW   : 0) |
+         (ANG_EF::test(angReg)  ? A1335_STATUS_ERROR : 0) |
+         (parityOk(angReg)      ? 0 : A1335_STATUS_PARITY);
+}
+
+byte      A1335::busStatus(byte error){     // translates a transport error code
+  switch (error) {
+    case 0:
+      return 0;
+    case 2:
+    case 3:
+      return A1335_STATUS_BUS | A1335_STATUS_NACK;
+    case A1335_SHORT_READ:
+      return A1335_STATUS_BUS | A1335_STATUS_SHORT;
+    default:
+      return A1335_STATUS_BUS;
+  }
+}
+
+bool      A1335::parityOk(uint16_t reg){  // checks the odd parity of a register
+  reg ^= reg >> 8;
+  reg ^= reg >> 4;
+  reg ^= reg >> 2;
+  reg ^= reg >> 1;
+  return reg & 1;                   // the lowest bit now contains the parity of all bits in reg
+}
+
+byte      A1335::readAll(A1335Snapshot& snap){  // reads the whole register block ANG..FIELD at once
+  A1335_LOCK();
+  A1335_TRACE_BEGIN();
+  byte error = setPointer(ANG);     // choose first register, the sensor auto-increments from there
+  if (!error) {
+    error = fetchAll(snap);
+  }
+  A1335_TRACE_END(ANG, error);
+  return error;
+}
+
+byte      A1335::readSample(A1335Sample& sample, byte index){  // reads only ANG, with time and flags
+  A1335_LOCK();
+  A1335_STAMP_CLEAR(sample);
+  A1335_STAMP(sample, request);
+  uint16_t angReg;
+  byte error = normalRead(ANG, angReg);
+  sample.time   = micros();
+  sample.sensor = index;
+  if (error) {
+    sample.angle = 0;
+    sample.flags = busStatus(error);
+    return error;
+  }
+  sample.angle = corrected(ANG_ANGLE::get(angReg));
+  sample.flags = angleStatus(angReg);
+  A1335_STAMP(sample, decoded);
+  A1335_COUNT_ANGLE(sample.flags);
+  if (!(sample.flags & A1335_STATUS_PARITY)) {
+    noteAngle(angReg);
+  }
+  return 0;
+}
+
+bool      A1335::readAngleIfNew(A1335Sample& sample, byte index){  // the NEW flag is cleared by reading ANG
+  if (readSample(sample, index)) {
+    return false;
+  }
+  return (sample.flags & (A1335_STATUS_NEW | A1335_STATUS_INVALID)) == A1335_STATUS_NEW;
 }
 
+byte      A1335::setPointer(byte reg){  // sets the register pointer without reading
+  return bus->select(address, reg);
+}
+
+byte      A1335::readFrame(byte* frame){   // the block ANG..FIELD as raw bytes, decoded later by A1335Frame
+  A1335_LOCK();
+  A1335_TRACE_BEGIN();
+  byte error = setPointer(ANG);
+  if (!error) {
+    error = bus->receive(address, frame, A1335_FRAME_SIZE);
+  }
+  A1335_TRACE_END(ANG, error);
+  return error;
+}
+
+byte      A1335::fetchAll(A1335Snapshot& snap){  // reads ANG..FIELD, the pointer has to be at ANG already
+  const byte words = 6;             // ANG, STA, ERR, XERR, TSEN, FIELD
+  uint16_t* regs[words] = { &snap.angleReg, &snap.statusReg, &snap.errorReg,
+                            &snap.xerrorReg, &snap.tempReg, &snap.fieldReg };
+  byte buffer[2 * words];
+  byte error = bus->receive(address, buffer, 2 * words);
+  if (error) {
+    return error;                   // A1335_SHORT_READ if the sensor sent less
+  }
+  for (byte w = 0; w < words; w++){
+    *regs[w] = load_be16(buffer + 2 * w);  // data bytes come MSB first
+  }
+  decode(snap);
+  snap.angle = corrected(snap.angle);
+  A1335_COUNT_ANGLE(snap.status);
+  if (snap.parityOk) {              // ERR and XERR came along, no extra read
+    faultSet   = ERR_FLAGS::get(snap.errorReg) | A1335Faults(XERR_FLAGS::get(snap.xerrorReg)) << 16;
+    faultState = snap.errorFlag ? faultState | FAULT_SEEN : faultState & ~FAULT_SEEN;
+  }
+#if A1335_HEALTH
+  healthData.temp   = snap.temp;      // the housekeeping registers came along
+  healthData.field  = snap.field;
+  healthData.error  = ERR_FLAGS::get(snap.errorReg);
+  healthData.xerror = XERR_FLAGS::get(snap.xerrorReg);
+  healthData.valid  = B00001111;
+  checkHealth();
+#endif
+  return 0;
+}
+
+void      A1335::decode(A1335Snapshot& snap){  // fills the decoded values of a snapshot
+  snap.status    = angleStatus(snap.angleReg);
+  snap.parityOk  = parityOk(snap.angleReg);
+  snap.newAngle  = ANG_NEW::test(snap.angleReg);
+  snap.errorFlag = ANG_EF::test(snap.angleReg);
+  snap.angle     = ANG_ANGLE::get(snap.angleReg);
+  snap.temp      = TSEN_TEMP::get(snap.tempReg);
+  snap.field     = FIELD_FIELD::get(snap.fieldReg);
+}
+
+#if !A1335_NO_DOUBLE
 double    A1335::readTemp(){        // returns temperature in Kelvin
   return double(readTempRaw())/8.0;
 }
+#endif
+
+uint16_t  A1335::readTempCentiK(){  // returns temperature in 1/100 Kelvin
+  return A1335Fixed::tempCentiK(readTempRaw());
+}
 
 uint16_t  A1335::readTempRaw(){     // returns raw temperature data
-  bytes_2 tempReg(normalRead(TSEN));
-  tempReg.msBy(0) &= temp[0];         // mutes bits, that dont contain temperature data
-  return tempReg.in();
+  return TSEN_TEMP::get(normalRead(TSEN));
 }
 
+#if !A1335_NO_DOUBLE
 double    A1335::readField(){       // returns field strenght in Tesla
   return double(readFieldRaw())/10000.0;
 }
+#endif
 
 uint16_t  A1335::readFieldRaw(){    // returns raw field strenght data
-  bytes_2 fieldReg(normalRead(FIELD));
-  fieldReg.msBy(0) &= field[0];       // mutes bits, that dont contain temperature data
-  return fieldReg.in();
+  return FIELD_FIELD::get(normalRead(FIELD));
 }
 
-byte      A1335::readOutputRate(){  // reads the log2() of the sample rate 
-  bytes_4 oRate(extendedRead(ORATE));
-  return oRate.msBy(3);             // !!!  I don't know yet, which byte holds the output rate  !!!
+byte      A1335::readOutputRate(){  // reads the log2() of the sample rate and refreshes the shadow copy
+  uint32_t orate;
+  if (!extendedRead(ORATE, orate)) {
+    storeShadow(ORATE, orate);
+    outputRate = ORATE_RATE::get(orate);
+  }
+  return outputRate;
 }
 
-byte      A1335::setOutputRate(byte rate){  // sets the log2() of the sample rate => (ORate = 2^rate)
-  if (rate < 0) {
-    rate = 0;
-  } else if (rate >=8) {
-    rate = 7;
+byte      A1335::setOutputRate(byte rate, bool idle){  // sets the log2() of the sample rate => (ORate = 2^rate)
+  A1335_LOCK();
+  if (rate > ORATE_RATE::bits()) {
+    rate = ORATE_RATE::bits();
   }
-  bytes_2 idle_mode;
-  bytes_2 run_mode;
-  for (int i = 0; i < 2; i++){
-    idle_mode.msBy(i) = ipm[i];
-    run_mode.msBy(i)  = rpm[i];
+  uint32_t orate;
+  byte error = extendedReadCached(ORATE, orate);
+  if (error) {
+    return error;                         // the other bits of the register are unknown, do not touch it
   }
-  normalWrite(CTRL, idle_mode.in());
-  delayMicroseconds(150);
-  bytes_4 oRate;
-  oRate.msBy(3) = rate;
-  extendedWrite(ORATE, oRate.in());       // !!!  I don't know yet, which byte gets the output rate  !!!
-  delayMicroseconds(50);
-  normalWrite(CTRL, run_mode.in());
-  delayMicroseconds(150);
+  A1335ExtWrite write = { ORATE, ORATE_RATE::set(orate, rate) };  // keeps the other bits of the register
+  return configure(&write, 1, idle);      // nothing to do, no bus traffic and no idle time if the rate is set already
 }
 
-byte      A1335::normalWrite(byte reg, int16_t data){      // writes the 2 bytes in "bytes" to the register with address reg to the sensor with I2C address adress.
-  bytes_2 data_bytes(data);
-  Wire.beginTransmission(address);
-  Wire.write(reg);                                        // choose target register
-  for (int i = 0; i<2; i++){
-    Wire.write(data_bytes.msBy(i));                       // Writes data MSB first
+byte      A1335::configure(const A1335ExtWrite* writes, byte n, bool idle){  // one idle window for all writes
+  A1335_LOCK();
+  byte pending = 0;
+  for (byte i = 0; i < n; i++){
+    Shadow* copy = findShadow(writes[i].reg);
+    if (!copy || copy->value != writes[i].value) {
+      pending++;
+    }
   }
-  return Wire.endTransmission();
+  byte error = 0;
+  if (pending) {
+    bool cycle = idle && processorState == 2; // an idle sensor takes the writes as they are
+    if (cycle) {
+      error = command(CTRL_IDLE);
+      if (error) {
+        command(CTRL_RUN);                // the idle write may have arrived, never leave the sensor idle
+        return error;
+      }
+    }
+    for (byte i = 0; i < n && !error; i++){
+      error = extendedWriteCached(writes[i].reg, writes[i].value);
+    }
+    if (cycle) {
+      byte runError = command(CTRL_RUN);
+      if (!error) {
+        error = runError;
+      }
+    }
+  }
+  Shadow* copy = findShadow(ORATE);
+  if (copy) {
+    outputRate = ORATE_RATE::get(copy->value);
+  }
+  return error;
+}
+
+byte      A1335::command(uint16_t ctrl, bool wait){  // CTRL and KEY in one write
+  A1335_LOCK();
+  byte key = byte(ctrl);
+  if (key != byte(CTRL_IDLE) && key != byte(CTRL_SRE)) {
+    return 4;                             // words with different keys were combined
+  }
+  byte error = normalWrite(CTRL, ctrl);
+  if (error || key != byte(CTRL_IDLE)) {
+    return error;                         // after a reset the sensor boots, start() it again
+  }
+  if ((ctrl & CTRL_RUN & 0xFF00) == (CTRL_RUN & 0xFF00)) {
+    processorState = 2;
+    return wait ? waitPhase(1) : 0;
+  }
+  if (ctrl & CTRL_IDLE & 0xFF00) {
+    processorState = 1;
+    return wait ? waitPhase(0) : 0;
+  }
+  return 0;
+}
+
+byte      A1335::normalWrite(byte reg, int16_t data){      // writes the 2 bytes in "bytes" to the register with address reg to the sensor with I2C address adress.
+  A1335_LOCK();
+  byte buffer[2];
+  store_be16(buffer, data);                               // Writes data MSB first
+  return bus->write(address, reg, buffer, 2);
 }
 
 byte      A1335::extendedWrite(int16_t reg, int32_t data){ // writes the 4 bytes in "bytes" to the extended register with address reg to the sensor with I2C address adress.
-  bytes_4 data_bytes(data);
-  Wire.beginTransmission(address);
-  Wire.write(EWA);                                        // choose write Register
-  Wire.write(byte(reg >> 8));                             // Fill with target address
-  Wire.write(byte(reg));
-  for (int i = 0; i<4; i++){
-    Wire.write(data_bytes.msBy(i));                       // Writes data MSB first
+  A1335_LOCK();
+  byte buffer[7];
+  store_be16(buffer, reg);                                // Fill EWA with target address
+  store_be32(buffer + 2, data);                           // Writes data MSB first
+  buffer[6] = 0x80;                                       // Confirm write
+  if (bus->write(address, EWA, buffer, 7)) {
+    return 0;
   }
-  Wire.write(0x80);                                       // Confirm write
-  Wire.endTransmission();
-  delayMicroseconds(10);
-  Wire.requestFrom(address, 1);
-  return Wire.read();                                     // Returns 1 if it works
+  byte wstate = 0;
+  waitExtended(EWCS + 1, &wstate, 1);                     // the pointer is at the status byte of EWCS now
+  return wstate;                                          // Returns 1 if it works
 }
 
 int16_t   A1335::normalRead(byte reg){
-  bytes_2 data;
-  Wire.beginTransmission(address);
-  Wire.write(reg);                // choose target Register
-  Wire.endTransmission();
-  Wire.requestFrom(address, 2);
-  for(int i=0; i< 2; i++){
-    if (Wire.available()){
-      data.msBy(i) = Wire.read();   // read data bytes
+  uint16_t data;
+  normalRead(reg, data);                  // bytes that did not arrive read as 0
+  return data;
+}
+
+byte      A1335::normalRead(byte reg, uint16_t& data){
+  A1335_LOCK();
+  byte buffer[2] = { 0, 0 };
+  A1335_TRACE_BEGIN();
+  byte error = bus->read(address, reg, buffer, 2);
+  A1335_TRACE_END(reg, error);
+  data = load_be16(buffer);
+  return error;
+}
+
+int32_t   A1335::extendedRead(int16_t reg){
+  uint32_t data;
+  extendedRead(reg, data);          // 0 if it failed
+  return data;
+}
+
+byte      A1335::extendedRead(int16_t reg, uint32_t& data){
+  A1335_LOCK();
+  byte request[3] = { byte(reg >> 8), byte(reg), 0x80 };  // target address, confirm read
+  byte buffer[5] = { 0, 0, 0, 0, 0 };
+  A1335_TRACE_BEGIN();
+  byte error = bus->write(address, ERA, request, 3);
+  if (!error) {
+    error = waitExtended(ERCS + 1, buffer, 5);  // status byte followed by the data bytes
+  }
+  A1335_TRACE_END(ERD, error);
+  data = error ? 0 : load_be32(buffer + 1);
+  return error;
+}
+
+byte      A1335::extendedReadMany(const uint16_t* regs, uint32_t* out, byte n){
+  A1335_LOCK();
+  byte result = 0;
+  for (byte i = 0; i < n; i++){   // each request goes out as soon as the previous data arrived
+    byte error = extendedRead(regs[i], out[i]);
+    if (error && !result) {
+      result = error;
     }
   }
-  return data.in();
+  return result;
 }
 
-int32_t   A1335::extendedRead(int16_t reg){
-  bytes_4 data;
-  byte rstate;
-  Wire.beginTransmission(address);
-  Wire.write(ERA);                // choose write Register
-  Wire.write(byte(reg >> 8));     // Fill with target address
-  Wire.write(byte(reg));
-  Wire.write(0x80);               // Confirm read
-  Wire.endTransmission();
-  delayMicroseconds(10);
-  Wire.requestFrom(address,5);
-  rstate = Wire.read();           // Reads status byte
-  for(int i=0; i < 4; i++){
-    if (Wire.available()){
-      data.msBy(i) = Wire.read();    // Reads data bytes
+byte      A1335::waitExtended(byte statusReg, byte* data, byte length){  // polls the done flag of an extended access
+  uint32_t begin = micros();
+  byte error = bus->receive(address, data, length);  // the write of the request left the pointer at statusReg
+  while (!error && !(data[0] & EXT_DONE)) {
+    if (micros() - begin > A1335_EXT_TIMEOUT_US) {
+      return 5;                     // timeout, like Wire
+    }
+    error = bus->read(address, statusReg, data, length);
+  }
+  return error;
+}
+
+
+
+//--- Instrumentation ---//
+
+#if A1335_INSTRUMENTATION
+const A1335Stats& A1335::stats(){
+  return statistics;
+}
+
+void      A1335::resetStats(){
+  memset(&statistics, 0, sizeof(statistics));
+}
+
+void      A1335::setTraceHook(A1335TraceHook hook){
+  traceHook = hook;
+}
+
+void      A1335::recordTransfer(byte reg, byte error, uint32_t begin){  // counts one transfer and hands it to the trace hook
+  uint32_t duration = micros() - begin;
+  byte status = busStatus(error);
+  statistics.transfers++;
+  statistics.busTime += duration;
+  if (status & A1335_STATUS_NACK) {
+    statistics.nacks++;
+  }
+  if (status & A1335_STATUS_SHORT) {
+    statistics.shortReads++;
+  }
+  if (error == 5) {
+    statistics.timeouts++;
+  }
+  if (traceHook) {
+    traceHook(*this, reg, status, duration);
+  }
+}
+
+void      A1335::recordAngle(byte status){
+  statistics.angles++;
+  if (status & A1335_STATUS_PARITY) {
+    statistics.parityErrors++;
+  }
+  if (!(status & (A1335_STATUS_NEW | A1335_STATUS_BUS))) {
+    statistics.stale++;
+  }
+}
+#endif
+
+
+//--- Calibration ---//
+
+#if A1335_CALIBRATION
+bool      A1335::setCalibration(const A1335CalTable* table){
+  if (table && !table->valid()) {
+    return false;                       // e.g. an EEPROM that was never written
+  }
+  calibration = table;
+  return true;
+}
+#endif
+
+uint16_t  A1335::corrected(uint16_t raw){    // costs one pointer test without a table
+#if A1335_CALIBRATION
+  if (calibration) {
+    return A1335Calibration::correct(*calibration, raw);
+  }
+#endif
+  return raw;
+}
+
+
+//--- Errors ---//
+
+void      A1335::setErrorMasks(uint16_t erm, uint16_t xerm){
+  errorMask  = erm;
+  xerrorMask = xerm;
+  faultState |= FAULT_MASKS;
+  if (processorState != 4) {
+    writeErrorMasks();
+  }
+}
+
+A1335Faults A1335::faults(){
+  return faultSet;
+}
+
+byte      A1335::readFaults(){              // ERR and XERR are neighbours, one 4 byte read
+  A1335_LOCK();
+  byte buffer[4];
+  A1335_TRACE_BEGIN();
+  byte error = bus->read(address, ERR, buffer, 4);
+  A1335_TRACE_END(ERR, error);
+  if (error) {
+    return error;
+  }
+  uint16_t err  = ERR_FLAGS::get(load_be16(buffer));
+  uint16_t xerr = XERR_FLAGS::get(load_be16(buffer + 2));
+  faultSet = err | A1335Faults(xerr) << 16;
+#if A1335_HEALTH
+  healthData.error  = err;
+  healthData.xerror = xerr;
+  healthData.valid |= B00001100;
+  checkHealth();
+#endif
+  return 0;
+}
+
+byte      A1335::clearFaults(){             // CERR and CXERR share the key, so both fit in one CTRL word
+  byte error = command(CTRL_CERR | CTRL_CXERR);
+  if (!error) {
+    faultSet = 0;
+    faultState &= ~FAULT_SEEN;
+  }
+  return error;
+}
+
+void      A1335::noteAngle(uint16_t angReg){  // nothing to do while there are no errors
+  if (!ANG_EF::test(angReg)) {
+    faultSet = 0;
+    faultState &= ~FAULT_SEEN;
+  } else if (!(faultState & FAULT_SEEN)) {
+    faultState |= FAULT_SEEN;           // read once when the flag turns on, not on every angle
+    readFaults();
+  }
+}
+
+byte      A1335::waitPhase(byte phase){  // the sensor finishes the current angle before it goes idle
+  uint32_t begin = micros();
+  for (;;) {
+    uint16_t state;
+    byte error = normalRead(STA, state);
+    if (error) {
+      return error;
+    }
+    if (STA_MPS::get(state) == 1 && STA_PHASE::get(state) == phase) {
+      return 0;
+    }
+    if (micros() - begin > A1335_CTRL_TIMEOUT_US) {
+      return 5;
+    }
+  }
+}
+
+byte      A1335::writeErrorMasks(){
+  A1335_LOCK();
+  byte buffer[4];
+  store_be16(buffer, errorMask);          // ERM and XERM are neighbours, one 4 byte write
+  store_be16(buffer + 2, xerrorMask);
+  return bus->write(address, ERM, buffer, 4);
+}
+
+
+//--- Health monitor ---//
+
+#if A1335_HEALTH
+byte      A1335::housekeeping(){            // one 2 byte read per call, round robin
+  A1335_LOCK();
+  const byte regs[4] = { TSEN, FIELD, ERR, XERR };
+  uint16_t data;
+  byte error = normalRead(regs[healthNext], data);
+  if (error) {
+    return error;                     // the same register is tried again next time
+  }
+  switch (healthNext) {
+    case 0:
+      healthData.temp   = TSEN_TEMP::get(data);
+      break;
+    case 1:
+      healthData.field  = FIELD_FIELD::get(data);
+      break;
+    case 2:
+      healthData.error  = ERR_FLAGS::get(data);
+      break;
+    default:
+      healthData.xerror = XERR_FLAGS::get(data);
+  }
+  healthData.valid |= 1 << healthNext;
+  healthNext = (healthNext + 1) & 3;
+  checkHealth();
+  return 0;
+}
+
+const A1335Health& A1335::health(){
+  return healthData;
+}
+
+void      A1335::setHealthLimits(uint16_t minField_, uint16_t maxTemp_){
+  minField = minField_;
+  maxTemp  = maxTemp_;
+}
+
+void      A1335::onHealth(A1335HealthCallback callback){
+  healthCallback = callback;
+}
+
+void      A1335::checkHealth(){             // compares the cached values with the limits
+  byte events = 0;
+  if (minField && (healthData.valid & B00000010) && healthData.field < minField) {
+    events |= A1335_HEALTH_FIELD_LOW;
+  }
+  if (maxTemp && (healthData.valid & B00000001) && healthData.temp > maxTemp) {
+    events |= A1335_HEALTH_OVERTEMP;
+  }
+  if (healthData.error || healthData.xerror) {
+    events |= A1335_HEALTH_ERROR;
+  }
+  if (events != healthData.events) {
+    healthData.events = events;
+    if (healthCallback) {
+      healthCallback(*this, events);
+    }
+  }
+}
+#endif
+
+
+//--- Shadow copies of extended registers ---//
+
+int32_t   A1335::extendedReadCached(int16_t reg){
+  uint32_t value;
+  extendedReadCached(reg, value);       // 0 if it failed
+  return value;
+}
+
+byte      A1335::extendedReadCached(int16_t reg, uint32_t& data){
+  A1335_LOCK();
+  Shadow* copy = findShadow(reg);
+  if (copy) {
+    data = copy->value;
+    return 0;
+  }
+  byte error = extendedRead(reg, data);
+  if (!error) {
+    storeShadow(reg, data);             // only a value that was read is kept
+  }
+  return error;
+}
+
+byte      A1335::extendedWriteCached(int16_t reg, int32_t data){
+  A1335_LOCK();
+  Shadow* copy = findShadow(reg);
+  if (copy && copy->value == uint32_t(data)) {
+    return 0;                             // the sensor has it already
+  }
+  byte wstate = extendedWrite(reg, data);
+  if (!(wstate & EXT_DONE)) {
+    if (copy) {
+      *copy = shadow[--shadowCount];      // the register content is unknown now, drop the copy
+    }
+    return 4;
+  }
+  storeShadow(reg, data);
+  return 0;
+}
+
+void      A1335::clearShadow(){
+  shadowCount = 0;
+}
+
+A1335::Shadow* A1335::findShadow(uint16_t reg){
+  for (byte i = 0; i < shadowCount; i++){
+    if (shadow[i].reg == reg) {
+      return &shadow[i];
     }
   }
-  return data.in();
+  return nullptr;
+}
+
+void      A1335::storeShadow(uint16_t reg, uint32_t value){  // updates the copy, takes a free or the oldest slot
+  Shadow* copy = findShadow(reg);
+  if (!copy) {
+    if (shadowCount < A1335_SHADOW_SLOTS) {
+      copy = &shadow[shadowCount++];
+    } else {
+      for (byte i = 1; i < A1335_SHADOW_SLOTS; i++){
+        shadow[i - 1] = shadow[i];
+      }
+      copy = &shadow[A1335_SHADOW_SLOTS - 1];
+    }
+  }
+  copy->reg   = reg;
+  copy->value = value;
 }
 
 
+#if A1335_ASYNC
+//--- Asynchronous reads ---//
+
+byte      A1335::beginReadAngle(){          // sets the pointer to ANG, the data is fetched by poll()
+  if (asyncState != ASYNC_IDLE) {
+    return 4;
+  }
+#if A1335_RTOS
+  bus->lock();                          // held until the read finished, poll() has to run in the same task
+#endif
+  byte error = setPointer(ANG);
+  if (!error) {
+    asyncState = ASYNC_ANGLE;
+  }
+#if A1335_RTOS
+  if (error) {
+    bus->unlock();
+  }
+#endif
+  return error;
+}
+
+byte      A1335::beginReadAll(A1335Snapshot& snap){  // sets the pointer to ANG, the block is fetched by poll()
+  if (asyncState != ASYNC_IDLE) {
+    return 4;
+  }
+#if A1335_RTOS
+  bus->lock();                          // held until the read finished, poll() has to run in the same task
+#endif
+  byte error = setPointer(ANG);
+  if (!error) {
+    asyncSnap  = &snap;
+    asyncState = ASYNC_ALL;
+  }
+#if A1335_RTOS
+  if (error) {
+    bus->unlock();
+  }
+#endif
+  return error;
+}
+
+byte      A1335::beginExtendedRead(int16_t reg){  // requests an extended read, the sensor needs some time to fetch it
+  if (asyncState != ASYNC_IDLE) {
+    return 4;
+  }
+  byte request[3] = { byte(reg >> 8), byte(reg), 0x80 };  // target address, confirm read
+#if A1335_RTOS
+  bus->lock();                          // held until the read finished, poll() has to run in the same task
+#endif
+  byte error = bus->write(address, ERA, request, 3);
+  if (!error) {
+    asyncStart = micros();
+    asyncState = ASYNC_EXTENDED;
+  }
+#if A1335_RTOS
+  if (error) {
+    bus->unlock();
+  }
+#endif
+  return error;
+}
+
+bool      A1335::poll(){                    // does the next step of a pending read, never waits
+  switch (asyncState) {
+    case ASYNC_IDLE:
+      return true;
+    case ASYNC_ANGLE: {
+      int32_t value = 0;
+      byte buffer[2];
+      A1335_TRACE_BEGIN();
+      byte error = bus->receive(address, buffer, 2);
+      A1335_TRACE_END(ANG, error);
+      byte status = busStatus(error);
+      if (!error) {
+        uint16_t angReg = load_be16(buffer);
+        status = angleStatus(angReg);
+        A1335_COUNT_ANGLE(status);
+        if (parityOk(angReg)) {         // odd Parity in this register => a 0 means an error
+          value = corrected(ANG_ANGLE::get(angReg));
+          noteAngle(angReg);
+        }
+      }
+      finishAsync(value, error, status);
+      return true;
+    }
+    case ASYNC_ALL: {
+      byte error = fetchAll(*asyncSnap);
+      finishAsync(error ? 0 : asyncSnap->angle, error, error ? busStatus(error) : asyncSnap->status);
+      return true;
+    }
+    case ASYNC_EXTENDED: {
+      uint32_t elapsed = micros() - asyncStart;
+      byte buffer[5];
+      byte error = bus->receive(address, buffer, 5);
+      if (error) {
+        finishAsync(0, error, busStatus(error));
+        return true;
+      }
+      byte rstate = buffer[0];    // Reads status byte
+      if (!(rstate & EXT_DONE)) {
+        if (elapsed > A1335_EXT_TIMEOUT_US) {
+          finishAsync(0, 5, busStatus(5));
+        } else {
+          setPointer(ERCS + 1);   // try again with the next poll()
+        }
+        return asyncState == ASYNC_IDLE;
+      }
+      finishAsync(load_be32(buffer + 1), 0, 0);
+      return true;
+    }
+  }
+  return true;
+}
+
+bool      A1335::busy(){
+  return asyncState != ASYNC_IDLE;
+}
+
+int32_t   A1335::asyncResult(){
+  return asyncValue;
+}
+
+byte      A1335::asyncError(){
+  return asyncErr;
+}
+
+byte      A1335::asyncStatus(){
+  return asyncFlags;
+}
+
+void      A1335::onComplete(A1335Callback callback){
+  asyncCallback = callback;
+}
+
+void      A1335::finishAsync(int32_t value, byte error, byte status){  // stores the result and notifies the callback
+  asyncValue = value;
+  asyncErr   = error;
+  asyncFlags = status;
+  asyncState = ASYNC_IDLE;
+  asyncSnap  = nullptr;
+#if A1335_RTOS
+  bus->unlock();
+#endif
+  if (asyncCallback) {
+    asyncCallback(*this, value, error);
+  }
+}
+#endif
@@ -16,6 +16,14 @@
      #include "WProgram.h"
 #endif
 #include <Wire.h>
+#include "A1335Config.h"
+#include "A1335Registers.h"
+#include "A1335Fixed.h"
+#include "A1335Calibration.h"
+#include "A1335Transport.h"
+
+// bytes_2 and bytes_4 are kept for sketches using them. The library itself packs bytes
+// with load_be16() / store_be16() etc. from A1335Registers.h
 
 class bytes_2 { // allows easy conversion from two bytes in a given order to a 16 bit int.
 public:
@@ -50,11 +58,149 @@ private:
   }data;
 };
 
+struct A1335Snapshot { // decoded copy of the register block ANG..FIELD (0x20 - 0x2B), read in one transfer
+  uint16_t  angleReg;           // raw register contents, as read from the sensor
+  uint16_t  statusReg;
+  uint16_t  errorReg;
+  uint16_t  xerrorReg;
+  uint16_t  tempReg;
+  uint16_t  fieldReg;
+
+  uint16_t  angle;              // raw angle data (4096 = 360 deg)
+  uint16_t  temp;               // raw temperature data 8 = 1 K
+  uint16_t  field;              // raw field strenght data 10 = 1mT
+  bool      newAngle;           // a new angle was in the angle register
+  bool      errorFlag;          // at least one error in register 0x24
+  bool      parityOk;           // odd parity of the angle register was correct
+  byte      status;             // A1335_STATUS_* bits of the angle
+};
+
+// Status bits of samples, snapshots and results, all taken from the same transfer as the value
+const byte A1335_STATUS_NEW    = B00000001;    // the angle was new since the last read
+const byte A1335_STATUS_ERROR  = B00000010;    // the sensor reported at least one error in register 0x24 (EF flag)
+const byte A1335_STATUS_PARITY = B00000100;    // parity check of the angle register failed, angle is not valid
+const byte A1335_STATUS_BUS    = B00001000;    // the transfer failed, value is not valid
+const byte A1335_STATUS_NACK   = B00010000;    // the sensor did not acknowledge (with A1335_STATUS_BUS)
+const byte A1335_STATUS_SHORT  = B00100000;    // fewer bytes arrived than requested (with A1335_STATUS_BUS)
+
+const byte A1335_STATUS_INVALID = A1335_STATUS_PARITY | A1335_STATUS_BUS;
+
+typedef uint32_t A1335Faults;           // set of active errors: the ERR flags in bits 0..11, the XERR flags in bits 16..27
+
+constexpr A1335Faults A1335_FAULT_ERR(byte bit)  { return A1335Faults(1) << bit; }        // ERR flag 0..11
+constexpr A1335Faults A1335_FAULT_XERR(byte bit) { return A1335Faults(1) << (16 + bit); } // XERR flag 0..11
+
+const byte A1335_FRAME_SIZE = 12;       // bytes of the register block ANG..FIELD (0x20 - 0x2B) as it comes off the bus
+
+struct A1335Result {    // a register value and how it was read
+  uint16_t  value;              // the decoded value, 0 if not valid
+  byte      status;             // A1335_STATUS_* bits
+
+  bool      ok() const { return !(status & A1335_STATUS_INVALID); }
+};
+
+#if A1335_TIMESTAMPS
+struct A1335Stamps {    // micros() at each stage of one sample, 0 = the stage was not passed
+  uint32_t  update;             // estimated update of the angle in the sensor, set by A1335Poller
+  uint32_t  request;            // start of the transfer. Its end is A1335Sample::time
+  uint32_t  decoded;            // angle decoded and corrected
+  uint32_t  pushed;             // stored in an A1335Ring or A1335Latest
+  uint32_t  popped;             // taken out of it by the consumer
+};
+
+  #define A1335_STAMP(sample, stage)      ((sample).stamps.stage = micros())
+  #define A1335_STAMP_CLEAR(sample)       ((sample).stamps = A1335Stamps())
+#else
+  #define A1335_STAMP(sample, stage)
+  #define A1335_STAMP_CLEAR(sample)
+#endif
+
+struct A1335Sample {    // one timestamped angle, 8 bytes so a whole bus fits in a few cache lines
+  uint32_t  time;               // micros() at the end of the transfer
+  uint16_t  angle;              // raw angle data (4096 = 360 deg)
+  byte      sensor;             // index of the sensor in the bus
+  byte      flags;              // A1335_STATUS_* flags
+#if A1335_TIMESTAMPS
+  A1335Stamps stamps;
+#endif
+};
+
+struct A1335ExtWrite {  // one extended register write for A1335::configure()
+  uint16_t  reg;
+  uint32_t  value;
+};
+
+struct A1335Settings {  // what start() reads from the extended registers, to be kept in EEPROM for a fast warm boot
+  byte      address;            // I2C address these settings belong to
+  uint32_t  orate;              // ORATE register
+  byte      check;              // checksum, set by A1335::saveSettings()
+
+  byte      checksum() const;
+  bool      valid() const;
+};
+
+#ifndef A1335_BASE_PERIOD_US
+#define A1335_BASE_PERIOD_US 32         // angle update period at output rate 0 in us
+#endif
+
+class A1335;
+
+typedef void (*A1335Callback)(A1335& sensor, int32_t value, byte error); // called when an asynchronous read completes
+
+#if A1335_HEALTH
+const byte A1335_HEALTH_FIELD_LOW  = B00000001;  // field strength below the limit, magnet too far away
+const byte A1335_HEALTH_OVERTEMP   = B00000010;  // temperature above the limit
+const byte A1335_HEALTH_ERROR      = B00000100;  // ERR or XERR has bits set
+
+struct A1335Health {    // latest housekeeping values of a sensor, raw as in the registers
+  uint16_t  temp;               // TSEN (8 = 1 K)
+  uint16_t  field;              // FIELD (1 = 1 G)
+  uint16_t  error;              // ERR
+  uint16_t  xerror;             // XERR
+  byte      valid;              // bit n set: the n-th value above was read
+  byte      events;             // A1335_HEALTH_* conditions that are active now
+};
+
+typedef void (*A1335HealthCallback)(A1335& sensor, byte events); // called when the active A1335_HEALTH_* conditions change
+#endif
+
+#if A1335_INSTRUMENTATION
+struct A1335Stats {     // counters of one sensor since start or resetStats()
+  uint32_t  transfers;          // register reads
+  uint32_t  busTime;            // time spent in them in us
+  uint32_t  nacks;              // transfers the sensor did not acknowledge
+  uint32_t  shortReads;         // transfers with fewer bytes than requested
+  uint32_t  timeouts;           // extended reads that did not finish
+  uint32_t  angles;             // angles decoded
+  uint32_t  parityErrors;       // angles with wrong parity
+  uint32_t  stale;              // angles without the NEW flag
+};
+
+typedef void (*A1335TraceHook)(A1335& sensor, byte reg, byte status, uint32_t duration);
+                                // called after every register read with its A1335_STATUS_* bits and duration in us
+#endif
+
 class A1335 {
 public:
-  A1335();  
+  A1335(A1335Transport& transport = A1335Wire);  // the sensor talks through transport, by default I2C on Wire
+
+  void      setTransport(A1335Transport& transport); // moves the sensor to another transport
+
+  byte      start(int16_t address_, const A1335Settings* settings = nullptr, const A1335CalTable* calibration = nullptr);
+							// starts the sensor at the given address. With valid settings for that address
+							// no extended registers are read. A valid calibration table is used for all angles.
+							// Returns 0 on success, the error of the ORATE read if that failed
+
+  byte      begin(int16_t address_, const A1335Settings* settings = nullptr, const A1335CalTable* calibration = nullptr);
+							// start() without the final 1 ms settle time, to start many sensors at once
 
-  byte      start(int16_t address_);	// starts the sensor at the given address
+  bool      saveSettings(A1335Settings& settings); // fills settings for the next start(). Returns false, and leaves
+							// settings invalid, if ORATE could not be read
+
+#if A1335_CALIBRATION
+  bool      setCalibration(const A1335CalTable* table); // corrects all angles with table from now on, nullptr = off.
+							// The table is not copied and has to stay valid. Returns false if it is not
+#endif
   
   int16_t   getAddress();			// returns I2C address
   byte      getProcessorState();		// returns processor state:
@@ -62,38 +208,219 @@ public:
 
   byte      getOutputRate();		// returns the log2() of the samperate. E.g. 3 would mean 8 samples per data point.
 
+  uint32_t  getSamplePeriod();		// returns the time between two new angles in us, A1335_BASE_PERIOD_US * 2^outputRate
+
   
+#if !A1335_NO_DOUBLE
   double    readAngle();			// returns the angle in degrees
+#endif
 
-  uint16_t  readAngleRaw();			// returns raw angle data (4096 = 360)
+  uint16_t  readAngleRaw();			// returns raw angle data (4096 = 360), 0 after a bus or parity error.
+							// readAngleResult() tells them apart
 
+  uint16_t  readAngleQ16();			// returns the angle in 1/65536 turns
+
+  uint16_t  readAngleCentideg();		// returns the angle in 1/100 degrees
+
+#if !A1335_NO_DOUBLE
   double    readTemp();			// returns temperature in Kelvin
+#endif
 
   uint16_t  readTempRaw();			// returns raw temperature data 8 = 1 K
 
+  uint16_t  readTempCentiK();		// returns temperature in 1/100 Kelvin
+
+#if !A1335_NO_DOUBLE
   double    readField();			// returns field strenght in Tesla
+#endif
 
   uint16_t  readFieldRaw();			// returns raw field strenght data 10 = 1mT
 
+  A1335Result readAngleResult();		// raw angle with parity, EF, NEW and bus status of the same read
+
+  A1335Result readTempResult();		// raw temperature with the bus status of the read
+
+  A1335Result readFieldResult();		// raw field strength with the bus status of the read
+
+  static byte busStatus(byte error);		// A1335_STATUS_* bits of a transport error code
+
+  byte      readAll(A1335Snapshot& snap);	// reads ANG, STA, ERR, XERR, TSEN and FIELD in one I2C transfer. Returns 0 on success
 
-  byte      readOutputRate();		// reads the log2() of the sample rate. Does not really work yet!
+  byte      readFrame(byte* frame);		// reads the same block undecoded, A1335_FRAME_SIZE bytes MSB first. Returns 0 on success
 
-  byte      setOutputRate(byte rate);// sets the log2() of the sample rate => (ORate = 2^rate). Does not really work yet!
+  byte      readSample(A1335Sample& sample, byte index = 0); // reads ANG into a timestamped sample tagged with index. Returns 0 on success
+
+  bool      readAngleIfNew(A1335Sample& sample, byte index = 0); // like readSample(), true only if the angle is valid and new since the last read
+
+
+  byte      readOutputRate();		// reads the log2() of the sample rate from the sensor, the last known rate if that fails
+
+  byte      setOutputRate(byte rate, bool idle = true); // sets the log2() of the sample rate => (ORate = 2^rate). Returns 0 on success.
+							// Does nothing if the rate is already set. idle = false skips the idle / run
+							// cycle, for parts that take a new rate while running
   
+  byte      configure(const A1335ExtWrite* writes, byte n, bool idle = true);
+							// writes n extended registers in one idle window: the sensor stops processing
+							// once, only for the registers that differ from their shadow copy. idle = false
+							// writes them while running. Returns 0 on success, else the first error
+
+  byte      command(uint16_t ctrl, bool wait = true); // writes a CTRL word from A1335Reg, e.g. CTRL_IDLE | CTRL_CERR.
+							// Words with the same key can be combined. With wait, polls STA until the sensor
+							// reached the requested idle / run phase. Returns 0 on success; 5 = timeout
+
   byte      normalWrite(byte reg, int16_t data); // writes 16 bit to a given register
 
   int16_t   normalRead(byte reg);			 // reads 16 bit from a given register
 
+  byte      normalRead(byte reg, uint16_t& data);	 // reads 16 bit from a given register. Returns 0 on success, like Wire.endTransmission()
+
   
   byte      extendedWrite(int16_t reg, int32_t data); // writes 32 bit to a given extended register
 
   int32_t   extendedRead(int16_t reg);			 // reads 32 bit from a given extended register
 
+  byte      extendedRead(int16_t reg, uint32_t& data);	 // reads 32 bit from a given extended register. Returns 0 on success, 5 on timeout
+
+  byte      extendedReadMany(const uint16_t* regs, uint32_t* out, byte n); // reads n extended registers back to back. Returns the first error
+
+  int32_t   extendedReadCached(int16_t reg);		 // returns the shadow copy of an extended register, reads it only if there is none
+
+  byte      extendedReadCached(int16_t reg, uint32_t& data); // the same with the error of the read. Returns 0 on success
+
+  byte      extendedWriteCached(int16_t reg, int32_t data); // writes an extended register only if data differs from the shadow copy. Returns 0 on success
+
+  void      clearShadow();				 // forgets all shadow copies, e.g. after the sensor was reset
+
+
+  // Errors: the EF flag comes with every angle. Only when it turns on, ERR and XERR are read, in one transfer
+
+  void      setErrorMasks(uint16_t erm, uint16_t xerm); // errors the sensor ignores (bit set = masked). Written by start(),
+							// or at once if the sensor is already started
+
+  A1335Faults faults();				// active errors as of the last angle read, 0 if it had no EF flag
+
+  byte      readFaults();			// reads ERR and XERR into faults(). Returns 0 on success
+
+  byte      clearFaults();			// clears ERR and XERR with a single CTRL write. Returns 0 on success
+
+
+#if A1335_ASYNC
+  // Asynchronous reads: begin*() only issues the request and returns. poll() has to be called
+  // until it returns true, i.e. from loop() or a timer task, the CPU is free in between.
+
+  byte      beginReadAngle();			// starts reading the raw angle. Returns 0 if the request was sent
+
+  byte      beginReadAll(A1335Snapshot& snap);	// starts a burst read into snap. snap has to stay valid until poll() returns true
+
+  byte      beginExtendedRead(int16_t reg);	// starts reading 32 bit from a given extended register
+
+  bool      poll();				// advances a pending read. Returns true once it is finished
+
+  bool      busy();				// true while an asynchronous read is pending
+
+  int32_t   asyncResult();			// value of the last finished asynchronous read
+
+  byte      asyncError();			// error of the last finished asynchronous read: 0 = ok; 5 = timeout; else transport error
+
+  byte      asyncStatus();			// A1335_STATUS_* bits of the last finished asynchronous read, like A1335Result.
+							// An angle with wrong parity reads as 0 with error 0 and A1335_STATUS_PARITY set
+
+  void      onComplete(A1335Callback callback); // sets a function to be called when an asynchronous read finishes
+#endif
+
+#if A1335_HEALTH
+  // Health monitor: housekeeping() reads one of TSEN, FIELD, ERR and XERR per call, in turn, so it can be slipped
+  // into the idle time after an angle read. readAll() refreshes all of them for free.
+
+  byte      housekeeping();			// reads the next housekeeping register and checks the limits. Returns 0 on success
+
+  const A1335Health& health();			// latest values, 0 until read
+
+  void      setHealthLimits(uint16_t minField, uint16_t maxTemp); // raw limits, 0 = not checked
+
+  void      onHealth(A1335HealthCallback callback); // sets a function to be called when a condition starts or ends
+#endif
+
+#if A1335_INSTRUMENTATION
+  const A1335Stats& stats();			// counters since start or resetStats()
+
+  void      resetStats();
+
+  void      setTraceHook(A1335TraceHook hook);	// sets a function to be called after every register read, nullptr to stop
+#endif
+
 
 private:
-  int16_t   address = 0x0C;             // I2C address
+  static bool parityOk(uint16_t reg);		// true if reg has odd parity
+  static byte angleStatus(uint16_t angReg);	// A1335_STATUS_* bits of an ANG register value
+  A1335Result readResult(byte reg, uint16_t (*get)(uint16_t));
+  static void decode(A1335Snapshot& snap);	// fills the decoded fields of snap from its raw registers
+  void      noteAngle(uint16_t angReg);	// keeps faults() in step with the EF flag of an ANG register value
+  uint16_t  corrected(uint16_t raw);		// raw angle through the calibration table, if there is one
+  byte      writeErrorMasks();
+  byte      waitPhase(byte phase);		// polls STA until the processor is in phase (STA_PHASE), 5 on timeout
+  byte      setPointer(byte reg);		// sets the register pointer for the next read
+  byte      fetchAll(A1335Snapshot& snap);	// reads the block ANG..FIELD from the current register pointer
+#if A1335_ASYNC
+  void      finishAsync(int32_t value, byte error, byte status);
+#endif
+#if A1335_HEALTH
+  void      checkHealth();			// updates the events and notifies the callback
+#endif
+  byte      waitExtended(byte statusReg, byte* data, byte length); // polls an extended access until it is done
+#if A1335_INSTRUMENTATION
+  void      recordTransfer(byte reg, byte error, uint32_t begin);
+  void      recordAngle(byte status);
+#endif
+
+  struct Shadow {                       // copy of an extended register as last read or written
+    uint32_t value;
+    uint16_t reg;
+  };
+  Shadow*   findShadow(uint16_t reg);
+  void      storeShadow(uint16_t reg, uint32_t value);
+
+  enum AsyncState : byte { ASYNC_IDLE, ASYNC_ANGLE, ASYNC_ALL, ASYNC_EXTENDED };
+  enum : byte { FAULT_MASKS = 1, FAULT_SEEN = 2 }; // masks were given; the last angle had the EF flag set
+
+  // Ordered by size so no padding is needed. See "Small microcontrollers" in README.md for the RAM per instance
+  A1335Transport* bus;                  // register access, I2C / SPI / mock
+#if A1335_ASYNC
+  A1335Snapshot* asyncSnap = nullptr;   // target of a pending burst read
+  A1335Callback  asyncCallback = nullptr;
+  int32_t   asyncValue = 0;             // value of the last asynchronous read
+  uint32_t  asyncStart = 0;             // micros() when the pending read was started
+#endif
+#if A1335_INSTRUMENTATION
+  A1335TraceHook traceHook = nullptr;
+  A1335Stats     statistics = {};
+#endif
+#if A1335_HEALTH
+  A1335HealthCallback healthCallback = nullptr;
+#endif
+#if A1335_CALIBRATION
+  const A1335CalTable* calibration = nullptr;
+#endif
+  Shadow    shadow[A1335_SHADOW_SLOTS];
+  A1335Faults faultSet = 0;
+  uint16_t  errorMask = 0;              // ERM and XERM for start()
+  uint16_t  xerrorMask = 0;
+#if A1335_HEALTH
+  uint16_t  minField = 0;
+  uint16_t  maxTemp = 0;
+  A1335Health healthData = {};
+  byte      healthNext = 0;             // housekeeping register read next: 0 = TSEN; 1 = FIELD; 2 = ERR; 3 = XERR
+#endif
+  byte      address = 0x0C;             // I2C address
   byte      processorState = 4;         // 0 = booting; 1 = idle; 2 = running; 3 = self-test mode; 4 = not found
-  byte      outputRate = 0;                 // log2() of the sample rate in the EEPROM
+  byte      outputRate = 0;             // log2() of the sample rate in the EEPROM
+  byte      shadowCount = 0;
+  byte      faultState = 0;             // FAULT_* bits
+#if A1335_ASYNC
+  AsyncState asyncState = ASYNC_IDLE;   // which kind of asynchronous read is pending
+  byte      asyncErr = 0;               // error code of the last asynchronous read
+  byte      asyncFlags = 0;             // A1335_STATUS_* bits of the last asynchronous read
+#endif
 };
 
 #endif //A1335_H
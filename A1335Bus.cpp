@@ -0,0 +1,159 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Bus manager: reads several A1335 on one bus back to back
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Bus.h"
+
+A1335Bus::A1335Bus(){
+
+}
+
+byte      A1335Bus::add(A1335& sensor, byte priority, byte divider){  // inserts the sensor sorted by priority
+  if (count >= A1335_BUS_MAX_SENSORS) {
+    return 0xFF;
+  }
+  if (divider == 0) {
+    divider = 1;
+  }
+  byte pos = count;
+  while (pos > 0 && slots[pos - 1].priority < priority) {
+    slots[pos] = slots[pos - 1];          // make room, equal priorities keep the order they were added in
+    pos--;
+  }
+  slots[pos].sensor    = &sensor;
+  slots[pos].index     = count;
+  slots[pos].priority  = priority;
+  slots[pos].divider   = divider;
+  slots[pos].countdown = count % divider; // spreads sensors with the same rate over the cycles
+  return count++;
+}
+
+byte      A1335Bus::scan(A1335Transport& transport, A1335* sensors, byte max,
+                         const byte* extra, byte nExtra,
+                         const A1335Settings* settings, byte nSettings){  // one sweep, one settle time for all
+  const byte first = 0x0C;              // default addresses of the A1335, set by its address pins
+  const byte last  = 0x0F;
+  byte found = 0;
+  failures = 0;
+  for (byte i = 0; i < (last - first + 1) + nExtra && found < max && count < A1335_BUS_MAX_SENSORS; i++){
+    byte address = i <= last - first ? first + i : extra[i - (last - first + 1)];
+    const A1335Settings* saved = nullptr;
+    for (byte s = 0; s < nSettings; s++){
+      if (settings[s].address == address) {
+        saved = &settings[s];
+      }
+    }
+    A1335& sensor = sensors[found];
+    sensor.setTransport(transport);
+    byte error = sensor.begin(address, saved);  // begin() probes the address first
+    if (error && sensor.getProcessorState() != 4) {
+      error = sensor.begin(address, saved);     // it answered, one more try for e.g. a timed out extended read
+    }
+    if (error) {
+      if (sensor.getProcessorState() != 4) {
+        failures++;
+      }
+      continue;
+    }
+    if (add(sensor) == 0xFF) {
+      break;
+    }
+    found++;
+  }
+  if (found) {
+    delay(1);
+  }
+  return found;
+}
+
+byte      A1335Bus::update(){               // one cycle: all due sensors are read without gaps in between
+  A1335Snapshot snap;
+  nSamples = 0;
+  for (byte i = 0; i < count; i++){
+    Slot& slot = slots[i];
+    if (slot.countdown) {
+      slot.countdown--;
+      continue;
+    }
+    slot.countdown = slot.divider - 1;
+
+    A1335Sample& sample = buffer[nSamples++];
+    A1335_STAMP_CLEAR(sample);
+    A1335_STAMP(sample, request);
+    byte error = slot.sensor->readAll(snap);
+    sample.time   = micros();
+    sample.sensor = slot.index;
+    if (error) {
+      sample.angle = 0;
+      sample.flags = A1335::busStatus(error);
+      continue;
+    }
+    sample.angle = snap.angle;
+    sample.flags = snap.status;
+    A1335_STAMP(sample, decoded);       // readAll() decodes before the end of the transfer is taken
+  }
+  cycleCount++;
+  return nSamples;
+}
+
+byte      A1335Bus::updateFrames(byte* frames, uint32_t* times, byte* index, byte* errors){  // no decoding, no copies
+  byte n = 0;
+  for (byte i = 0; i < count; i++){
+    Slot& slot = slots[i];
+    if (slot.countdown) {
+      slot.countdown--;
+      continue;
+    }
+    slot.countdown = slot.divider - 1;
+
+    byte* frame = frames + n * A1335_FRAME_SIZE;
+    byte error = slot.sensor->readFrame(frame);
+    if (error) {
+      memset(frame, 0, A1335_FRAME_SIZE); // fails the parity check when decoded
+    }
+    if (times) {
+      times[n] = micros();
+    }
+    if (index) {
+      index[n] = slot.index;
+    }
+    if (errors) {
+      errors[n] = error;
+    }
+    n++;
+  }
+  cycleCount++;
+  return n;
+}
+
+const A1335Sample* A1335Bus::samples(){
+  return buffer;
+}
+
+byte      A1335Bus::sampleCount(){
+  return nSamples;
+}
+
+byte      A1335Bus::sensorCount(){
+  return count;
+}
+
+byte      A1335Bus::scanFailures(){
+  return failures;
+}
+
+A1335*    A1335Bus::sensor(byte index){     // looks up a sensor by the index returned from add()
+  for (byte i = 0; i < count; i++){
+    if (slots[i].index == index) {
+      return slots[i].sensor;
+    }
+  }
+  return nullptr;
+}
+
+uint32_t  A1335Bus::cycles(){
+  return cycleCount;
+}
@@ -0,0 +1,66 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Bus manager: reads several A1335 on one bus back to back
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335BUS_H
+#define A1335BUS_H
+
+#include "A1335.h"
+
+#ifndef A1335_BUS_MAX_SENSORS
+#define A1335_BUS_MAX_SENSORS 8                 // sensors per bus, can be overridden before including this file
+#endif
+
+class A1335Bus {
+public:
+  A1335Bus();
+
+  byte      add(A1335& sensor, byte priority = 0, byte divider = 1);
+                                        // adds a sensor, read every divider-th cycle. Higher priority is read earlier in a cycle.
+                                        // Returns the index of the sensor or 0xFF if the bus is full
+
+  byte      scan(A1335Transport& transport, A1335* sensors, byte max,
+                 const byte* extra = nullptr, byte nExtra = 0,
+                 const A1335Settings* settings = nullptr, byte nSettings = 0);
+                                        // finds all sensors at 0x0C..0x0F and the extra addresses, starts them as
+                                        // sensors[0..] and adds them to the bus. Settings saved earlier are matched by
+                                        // address and skip the extended reads. Stops once the bus is full. Returns the
+                                        // number of sensors found, see scanFailures() for those that did not start
+
+  byte      update();                   // reads all sensors due in this cycle back to back. Returns the number of new samples
+
+  byte      updateFrames(byte* frames, uint32_t* times = nullptr, byte* index = nullptr, byte* errors = nullptr);
+                                        // one cycle like update(), but stores the raw frames of the due sensors back to back
+                                        // in frames (A1335_FRAME_SIZE bytes each, see A1335Frame.h to decode them) and the
+                                        // micros(), sensor index and transport error of each frame in the optional arrays.
+                                        // A frame that could not be read is all zero. Returns the number of frames
+
+  const A1335Sample* samples();         // samples of the last update(), ordered by read time
+  byte      sampleCount();              // number of samples of the last update()
+
+  byte      sensorCount();              // number of sensors on the bus
+  byte      scanFailures();             // sensors that answered the last scan() but did not start, even when tried twice
+  A1335*    sensor(byte index);         // sensor with the given index, nullptr if there is none
+  uint32_t  cycles();                   // number of update() calls so far
+
+private:
+  struct Slot {
+    A1335*  sensor;
+    byte    index;                      // index given by add()
+    byte    priority;
+    byte    divider;                    // read every divider-th cycle
+    byte    countdown;                  // cycles until the next read
+  };
+
+  Slot      slots[A1335_BUS_MAX_SENSORS];       // sorted by priority, highest first
+  A1335Sample buffer[A1335_BUS_MAX_SENSORS];
+  byte      count = 0;
+  byte      nSamples = 0;
+  byte      failures = 0;               // of the last scan()
+  uint32_t  cycleCount = 0;
+};
+
+#endif //A1335BUS_H
@@ -0,0 +1,30 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Angle linearization with a correction table
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Calibration.h"
+
+byte      A1335CalTable::checksum() const {
+  byte sum = 0x5A;
+  for (uint16_t i = 0; i < A1335_CAL_SIZE; i++){
+    sum = (sum << 1 | sum >> 7) ^ byte(error[i]);
+  }
+  return sum;
+}
+
+bool      A1335CalTable::valid() const {
+  return check == checksum();
+}
+
+void      A1335CalTable::seal(){
+  check = checksum();
+}
+
+void      A1335Calibration::apply(const A1335CalTable& table, uint16_t* angles, byte n){
+  for (byte i = 0; i < n; i++){
+    angles[i] = correct(table, angles[i]);
+  }
+}
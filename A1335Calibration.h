@@ -0,0 +1,45 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Angle linearization: a 256 entry correction table, applied
+  with one lookup and interpolation. The table is computed by
+  A1335Calibrator (A1335Calibrator.h) and can be kept in EEPROM.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335CALIBRATION_H
+#define A1335CALIBRATION_H
+
+#if (ARDUINO >= 100)
+     #include "Arduino.h"
+#else
+     #include "WProgram.h"
+#endif
+
+const uint16_t A1335_CAL_SIZE = 256;    // table entries, one every 16 raw counts
+
+struct A1335CalTable {  // error of the raw angle in counts at raw = 16 * i, to be subtracted. 257 bytes, EEPROM.put() it as a whole
+  int8_t    error[A1335_CAL_SIZE];
+  byte      check;              // checksum, set by A1335Calibrator::fit() or seal()
+
+  byte      checksum() const;
+  bool      valid() const;
+  void      seal();             // sets check after the table was changed by hand
+};
+
+class A1335Calibration {
+public:
+  static uint16_t correct(const A1335CalTable& table, uint16_t raw) {  // raw angle minus the interpolated error
+    byte i    = raw >> 4;
+    byte frac = raw & 0x0F;
+    int16_t e0 = table.error[i];
+    int16_t e1 = table.error[byte(i + 1)];  // wraps to entry 0 at 360 deg
+    int16_t e  = e0 + (((e1 - e0) * frac + 8) >> 4);
+    return (raw - e) & 0x0FFF;
+  }
+
+  static void apply(const A1335CalTable& table, uint16_t* angles, byte n); // corrects a column of raw angles in place,
+                                        // e.g. from A1335Frame::angles()
+};
+
+#endif //A1335CALIBRATION_H
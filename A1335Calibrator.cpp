@@ -0,0 +1,134 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Calibration: harmonic fit of the angle error over one
+  revolution at constant speed
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Calibrator.h"
+#include <math.h>
+
+const byte MAX_HARMONICS = 8;
+
+static int16_t wrapDelta(uint16_t to, uint16_t from){  // shortest way from one raw angle to another
+  return int16_t((to - from + 2048) & 0x0FFF) - 2048;
+}
+
+A1335Calibrator::A1335Calibrator(A1335Sample* buffer_, uint16_t capacity_) : buffer(buffer_), capacity(capacity_){
+
+}
+
+void      A1335Calibrator::reset(){
+  n    = 0;
+  span = 0;
+  rms  = 0;
+}
+
+bool      A1335Calibrator::add(const A1335Sample& sample){
+  if (complete() || n >= capacity) {
+    return complete();
+  }
+  if (sample.flags != A1335_STATUS_NEW) {
+    return false;                       // stale, flagged or invalid angles are not used
+  }
+  if (n) {
+    span += wrapDelta(sample.angle, buffer[n - 1].angle);
+  }
+  buffer[n++] = sample;
+  return complete();
+}
+
+bool      A1335Calibrator::complete(){
+  return span >= 4096 || span <= -4096;
+}
+
+uint16_t  A1335Calibrator::count(){
+  return n;
+}
+
+float     A1335Calibrator::residual(){
+  return rms;
+}
+
+bool      A1335Calibrator::fit(A1335CalTable& table, byte harmonics){
+  if (!complete()) {
+    return false;
+  }
+  if (harmonics > MAX_HARMONICS) {
+    harmonics = MAX_HARMONICS;
+  }
+  // use exactly one revolution, so every angle is covered once. The sample that completes it has almost
+  // the same angle and error as the first, so the two give the speed without the harmonics biasing it
+  uint16_t count = 0;
+  int32_t u = 0;
+  for (uint16_t i = 1; i < n; i++){
+    u += wrapDelta(buffer[i].angle, buffer[i - 1].angle);
+    if (u >= 4096 || u <= -4096) {
+      count = i;
+      break;
+    }
+  }
+  float speed = float(u) / float(buffer[count].time - buffer[0].time);
+
+  float meanT = 0, meanU = 0;           // the harmonics average out over the revolution, the line goes through the means
+  u = 0;
+  for (uint16_t i = 0; i < count; i++){
+    if (i) {
+      u += wrapDelta(buffer[i].angle, buffer[i - 1].angle);
+    }
+    meanT += float(buffer[i].time - buffer[0].time);
+    meanU += float(u);
+  }
+  meanT /= count;
+  meanU /= count;
+
+  // the residual of the line is the error, project it on the harmonics of the measured angle
+  const float step = 2 * M_PI / 4096;
+  float c[MAX_HARMONICS] = {}, s[MAX_HARMONICS] = {};
+  u = 0;
+  for (uint16_t i = 0; i < count; i++){
+    if (i) {
+      u += wrapDelta(buffer[i].angle, buffer[i - 1].angle);
+    }
+    float t = float(buffer[i].time - buffer[0].time) - meanT;
+    float r = float(u) - meanU - speed * t;
+    float phi = step * buffer[i].angle;
+    for (byte k = 0; k < harmonics; k++){
+      c[k] += r * cosf((k + 1) * phi);
+      s[k] += r * sinf((k + 1) * phi);
+    }
+  }
+  for (byte k = 0; k < harmonics; k++){
+    c[k] *= 2.0f / count;
+    s[k] *= 2.0f / count;
+  }
+
+  float sum = 0;
+  u = 0;
+  for (uint16_t i = 0; i < count; i++){
+    if (i) {
+      u += wrapDelta(buffer[i].angle, buffer[i - 1].angle);
+    }
+    float t = float(buffer[i].time - buffer[0].time) - meanT;
+    float r = float(u) - meanU - speed * t;
+    float phi = step * buffer[i].angle;
+    for (byte k = 0; k < harmonics; k++){
+      r -= c[k] * cosf((k + 1) * phi) + s[k] * sinf((k + 1) * phi);
+    }
+    sum += r * r;
+  }
+  rms = sqrtf(sum / count);
+
+  for (uint16_t j = 0; j < A1335_CAL_SIZE; j++){
+    float phi = step * (16 * j);
+    float e = 0;
+    for (byte k = 0; k < harmonics; k++){
+      e += c[k] * cosf((k + 1) * phi) + s[k] * sinf((k + 1) * phi);
+    }
+    long value = lroundf(e);
+    table.error[j] = int8_t(value > 127 ? 127 : value < -127 ? -127 : value);
+  }
+  table.seal();
+  return true;
+}
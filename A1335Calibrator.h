@@ -0,0 +1,41 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Calibration: captures one revolution at constant speed and
+  fits harmonics of the angle error into an A1335CalTable.
+  Uses floating point math, but only when linked in; the
+  correction at run time needs A1335Calibration.h alone.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335CALIBRATOR_H
+#define A1335CALIBRATOR_H
+
+#include "A1335.h"
+#include "A1335Calibration.h"
+
+class A1335Calibrator {
+public:
+  A1335Calibrator(A1335Sample* buffer_, uint16_t capacity_);
+                                        // buffer holds the capture, it should take at least a few hundred
+                                        // samples per revolution
+
+  void      reset();
+  bool      add(const A1335Sample& sample); // adds a valid, new sample. Returns true once one revolution is captured
+  bool      complete();                 // more than one revolution is in the buffer
+  uint16_t  count();                    // samples captured so far
+
+  bool      fit(A1335CalTable& table, byte harmonics = 4);
+                                        // fits harmonics 1..harmonics of the error and fills and seals table.
+                                        // Returns false if the capture is not complete
+  float     residual();                 // RMS error in counts left after the fit
+
+private:
+  A1335Sample* buffer;
+  uint16_t  capacity;
+  uint16_t  n = 0;
+  int32_t   span = 0;                   // unwrapped angle covered so far
+  float     rms = 0;
+};
+
+#endif //A1335CALIBRATOR_H
@@ -0,0 +1,61 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Build options. Change them here or define them before the
+  first include of A1335.h.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335CONFIG_H
+#define A1335CONFIG_H
+
+#ifndef A1335_TINY
+#define A1335_TINY 0            // 1 = smallest RAM and flash use for ATtiny class parts: the defaults below
+#endif                          // change to no double, one shadow slot, no asynchronous reads, no health monitor
+                                // and no calibration
+
+#ifndef A1335_NO_DOUBLE
+#define A1335_NO_DOUBLE A1335_TINY // 1 = leave out readAngle(), readTemp() and readField(), use the fixed point functions instead
+#endif
+
+#ifndef A1335_SHADOW_SLOTS
+#define A1335_SHADOW_SLOTS (A1335_TINY ? 1 : 2) // extended registers each A1335 keeps a copy of, 6 bytes each. At least 1
+#endif
+
+#ifndef A1335_EXT_TIMEOUT_US
+#define A1335_EXT_TIMEOUT_US 1000 // give up on an extended register access after this time
+#endif
+
+#ifndef A1335_CTRL_TIMEOUT_US
+#define A1335_CTRL_TIMEOUT_US 1000 // give up waiting for the idle or run phase after this time
+#endif
+
+#ifndef A1335_ASYNC
+#define A1335_ASYNC (!A1335_TINY) // 1 = beginReadAngle(), poll() etc. 15 bytes per A1335 on AVR
+#endif
+
+#ifndef A1335_HEALTH
+#define A1335_HEALTH (!A1335_TINY) // 1 = housekeeping() and the health callback. 17 bytes per A1335 on AVR
+#endif
+
+#ifndef A1335_CALIBRATION
+#define A1335_CALIBRATION (!A1335_TINY) // 1 = angles can be corrected with an A1335CalTable. 2 bytes per A1335 on AVR
+#endif
+
+#ifndef A1335_RTOS
+  #if defined(ARDUINO_ARCH_ESP32)
+    #define A1335_RTOS 1        // FreeRTOS is always there
+  #else
+    #define A1335_RTOS 0        // 1 = every A1335 call locks its transport, for several tasks on one bus. Needs FreeRTOS
+  #endif                        // for A1335Rtos.h
+#endif
+
+#ifndef A1335_INSTRUMENTATION
+#define A1335_INSTRUMENTATION 0 // 1 = count errors and bus time per sensor and call a trace hook. 0 costs nothing
+#endif
+
+#ifndef A1335_TIMESTAMPS
+#define A1335_TIMESTAMPS 0      // 1 = every A1335Sample carries the time of each stage of its read, see A1335Profiler.h.
+#endif                          // Adds 20 bytes per sample and a micros() call per stage
+
+#endif //A1335CONFIG_H
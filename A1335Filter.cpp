@@ -0,0 +1,201 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Host side filters for raw angles: moving average, CIC
+  decimator and median for glitch rejection.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Filter.h"
+
+const uint16_t ANGLE_MASK = 0x0FFF;
+const int32_t  REBASE     = int32_t(1) << 24;  // the unwrapped angles are moved back to 0 beyond this
+
+static int16_t angleStep(uint16_t from, uint16_t to){  // shortest signed way from one raw angle to another, -2048..2047
+  return int16_t((to - from) << 4) >> 4;
+}
+
+static bool    validSample(const A1335Sample& sample){
+  return !(sample.flags & A1335_STATUS_INVALID);
+}
+
+
+//--- Moving average ---//
+
+A1335MovingAverage::A1335MovingAverage(byte length_){
+  length = length_ == 0 ? 1 : (length_ > A1335_FILTER_MAX ? A1335_FILTER_MAX : length_);
+}
+
+void      A1335MovingAverage::reset(){
+  sum = 0;
+  unwrapped = 0;
+  next = 0;
+  filled = 0;
+}
+
+uint16_t  A1335MovingAverage::update(uint16_t raw){  // O(1): one value enters the sum, one leaves
+  raw &= ANGLE_MASK;
+  if (filled == 0) {
+    unwrapped = raw;
+  } else {
+    unwrapped += angleStep(lastRaw, raw);
+  }
+  lastRaw = raw;
+  if (filled == length) {
+    sum -= window[next];
+  } else {
+    filled++;
+  }
+  window[next] = unwrapped;
+  sum += unwrapped;
+  next = (next + 1) % length;
+
+  if (unwrapped > REBASE || unwrapped < -REBASE) {  // keeps the sum far from overflowing, whole turns only
+    int32_t turns = unwrapped & ~int32_t(ANGLE_MASK);
+    for (byte i = 0; i < filled; i++){
+      window[i] -= turns;
+    }
+    sum -= turns * filled;
+    unwrapped -= turns;
+  }
+
+  int32_t half = filled / 2;
+  int32_t mean = (sum >= 0 ? sum + half : sum - half) / filled;  // rounded to nearest
+  return uint16_t(mean) & ANGLE_MASK;
+}
+
+byte      A1335MovingAverage::process(const A1335Sample* in, byte n, A1335Sample* out){
+  byte count = 0;
+  for (byte i = 0; i < n; i++){
+    if (!validSample(in[i])) {
+      continue;
+    }
+    out[count] = in[i];
+    out[count].angle = update(in[i].angle);
+    count++;
+  }
+  return count;
+}
+
+
+//--- CIC decimator ---//
+
+A1335Cic::A1335Cic(byte order_, byte shift_){
+  order = order_ < 1 ? 1 : (order_ > MAX_ORDER ? MAX_ORDER : order_);
+  shift = shift_;
+  if (order * shift > 20) {             // the gain 2^(order*shift) times 4096 has to fit in 32 bit
+    shift = 20 / order;
+  }
+  reset();
+}
+
+void      A1335Cic::reset(){
+  for (byte i = 0; i < MAX_ORDER; i++){
+    integrator[i] = 0;
+    comb[i] = 0;
+  }
+  unwrapped = 0;
+  started = false;
+  phase = 0;
+  warmup = order - 1;
+}
+
+bool      A1335Cic::update(uint16_t raw, uint16_t& out){  // integrators at the input rate, combs at the output rate
+  raw &= ANGLE_MASK;
+  if (!started) {
+    unwrapped = raw;
+    started = true;
+  } else {
+    unwrapped += uint32_t(int32_t(angleStep(lastRaw, raw)));  // wraps modulo 2^32 on a shaft that keeps turning,
+  }                                     // which is a whole number of turns and drops out of the output
+  lastRaw = raw;
+
+  uint32_t value = unwrapped;           // unsigned, so the wrap modulo 2^32 is well defined
+  for (byte i = 0; i < order; i++){
+    integrator[i] = int32_t(uint32_t(integrator[i]) + value);
+    value = uint32_t(integrator[i]);
+  }
+  phase++;
+  if (phase >> shift == 0) {
+    return false;
+  }
+  phase = 0;
+  for (byte i = 0; i < order; i++){
+    uint32_t previous = uint32_t(comb[i]);
+    comb[i] = int32_t(value);
+    value -= previous;
+  }
+  if (warmup) {
+    warmup--;                           // the combs still hold the zeros from before the first sample
+    return false;
+  }
+  out = uint16_t(value >> (order * shift)) & ANGLE_MASK;  // divides by the gain 2^(order*shift)
+  return true;
+}
+
+byte      A1335Cic::process(const A1335Sample* in, byte n, A1335Sample* out){
+  byte count = 0;
+  for (byte i = 0; i < n; i++){
+    uint16_t angle;
+    if (validSample(in[i]) && update(in[i].angle, angle)) {
+      out[count] = in[i];
+      out[count].angle = angle;
+      count++;
+    }
+  }
+  return count;
+}
+
+
+//--- Median ---//
+
+A1335Median::A1335Median(byte length_){
+  if (length_ < 3) {
+    length_ = 3;
+  } else if (length_ > A1335_FILTER_MAX) {
+    length_ = A1335_FILTER_MAX;
+  }
+  length = length_ | 1;                 // odd, so there is a middle element
+  if (length > A1335_FILTER_MAX) {
+    length -= 2;
+  }
+}
+
+void      A1335Median::reset(){
+  next = 0;
+  filled = 0;
+}
+
+uint16_t  A1335Median::update(uint16_t raw){  // sorts the window as steps from the newest angle, so the wrap does not matter
+  raw &= ANGLE_MASK;
+  window[next] = raw;
+  next = (next + 1) % length;
+  if (filled < length) {
+    filled++;
+  }
+
+  int16_t steps[A1335_FILTER_MAX];
+  for (byte i = 0; i < filled; i++){
+    int16_t step = angleStep(raw, window[i]);
+    byte j = i;
+    while (j > 0 && steps[j - 1] > step) { // insertion sort, the window is short
+      steps[j] = steps[j - 1];
+      j--;
+    }
+    steps[j] = step;
+  }
+  return uint16_t(raw + steps[filled / 2]) & ANGLE_MASK;
+}
+
+byte      A1335Median::process(const A1335Sample* in, byte n, A1335Sample* out){
+  byte count = 0;
+  for (byte i = 0; i < n; i++){
+    if (!validSample(in[i])) {
+      continue;
+    }
+    out[count] = in[i];
+    out[count].angle = update(in[i].angle);
+    count++;
+  }
+  return count;
+}
@@ -0,0 +1,81 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Host side filters for raw angles: moving average, CIC
+  decimator and median for glitch rejection. All of them
+  handle the wrap from 4095 to 0 and use integer math only.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335FILTER_H
+#define A1335FILTER_H
+
+#include "A1335.h"
+
+#ifndef A1335_FILTER_MAX
+#define A1335_FILTER_MAX 32                     // longest window of the moving average / median
+#endif
+
+// One filter instance per sensor. update() takes one raw angle, process() a batch of samples
+// (e.g. from A1335Ring::popBatch()) and skips invalid ones. Output samples keep the time and
+// flags of the input sample that completed them.
+
+class A1335MovingAverage {
+public:
+  A1335MovingAverage(byte length_ = 8); // average over length samples, 1..A1335_FILTER_MAX
+
+  uint16_t  update(uint16_t raw);       // adds a raw angle, returns the average of the window
+  byte      process(const A1335Sample* in, byte n, A1335Sample* out);  // one output per valid input. Returns the number of outputs
+  void      reset();
+
+private:
+  int32_t   window[A1335_FILTER_MAX];   // unwrapped angles
+  int32_t   sum = 0;
+  int32_t   unwrapped = 0;
+  uint16_t  lastRaw = 0;
+  byte      length;
+  byte      next = 0;
+  byte      filled = 0;
+};
+
+
+class A1335Cic {
+public:
+  A1335Cic(byte order_ = 2, byte shift_ = 3);
+                                        // order 1..3 stages, decimation by 2^shift. order * shift has to be 20 or less
+
+  bool      update(uint16_t raw, uint16_t& out);  // adds a raw angle, true every 2^shift samples with the decimated angle in out.
+                                        // The first output comes after order * 2^shift samples, when the filter is settled
+  byte      process(const A1335Sample* in, byte n, A1335Sample* out);  // one output per 2^shift valid inputs
+  void      reset();
+
+private:
+  static const byte MAX_ORDER = 3;
+  int32_t   integrator[MAX_ORDER];      // wraps modulo 2^32, which the combs undo exactly
+  int32_t   comb[MAX_ORDER];
+  uint32_t  unwrapped = 0;              // modulo 2^32, the output only needs it modulo 4096 * gain
+  uint16_t  lastRaw = 0;
+  bool      started = false;
+  byte      order;
+  byte      shift;
+  uint32_t  phase = 0;                  // inputs since the last output, up to 2^20
+  byte      warmup;                     // outputs still to drop after reset, order - 1
+};
+
+
+class A1335Median {
+public:
+  A1335Median(byte length_ = 5);        // median of the last length samples, odd length 3..A1335_FILTER_MAX
+
+  uint16_t  update(uint16_t raw);       // adds a raw angle, returns the median of the window
+  byte      process(const A1335Sample* in, byte n, A1335Sample* out);
+  void      reset();
+
+private:
+  uint16_t  window[A1335_FILTER_MAX];
+  byte      length;
+  byte      next = 0;
+  byte      filled = 0;
+};
+
+#endif //A1335FILTER_H
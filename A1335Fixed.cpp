@@ -0,0 +1,60 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Fixed point conversions, no floating point math needed.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Fixed.h"
+
+// sin() of the first quarter turn in 128 steps, Q15. Lives in flash.
+const int16_t sinTable[129] PROGMEM = {
+      0,   402,   804,  1206,  1608,  2009,  2410,  2811,
+   3212,  3612,  4011,  4410,  4808,  5205,  5602,  5998,
+   6393,  6786,  7179,  7571,  7962,  8351,  8739,  9126,
+   9512,  9896, 10278, 10659, 11039, 11417, 11793, 12167,
+  12539, 12910, 13279, 13645, 14010, 14372, 14732, 15090,
+  15446, 15800, 16151, 16499, 16846, 17189, 17530, 17869,
+  18204, 18537, 18868, 19195, 19519, 19841, 20159, 20475,
+  20787, 21096, 21403, 21705, 22005, 22301, 22594, 22884,
+  23170, 23452, 23731, 24007, 24279, 24547, 24811, 25072,
+  25329, 25582, 25832, 26077, 26319, 26556, 26790, 27019,
+  27245, 27466, 27683, 27896, 28105, 28310, 28510, 28706,
+  28898, 29085, 29268, 29447, 29621, 29791, 29956, 30117,
+  30273, 30424, 30571, 30714, 30852, 30985, 31113, 31237,
+  31356, 31470, 31580, 31685, 31785, 31880, 31971, 32057,
+  32137, 32213, 32285, 32351, 32412, 32469, 32521, 32567,
+  32609, 32646, 32678, 32705, 32728, 32745, 32757, 32765,
+  32767,
+};
+
+int16_t   A1335Fixed::quarterSin(uint16_t x){  // sin() for x = 0..1024 (0..90 deg), linear interpolation between table entries
+  byte index = x >> 3;
+  byte frac  = x & 7;
+  int16_t a = pgm_read_word(&sinTable[index]);
+  if (!frac) {
+    return a;
+  }
+  int16_t b = pgm_read_word(&sinTable[index + 1]);
+  return a + ((int32_t(b - a) * frac) >> 3);
+}
+
+int16_t   A1335Fixed::sinQ15(uint16_t raw){  // folds the angle into the first quarter turn
+  raw &= 0x0FFF;
+  uint16_t x = raw & 0x03FF;
+  switch (raw >> 10) {
+    case 0:  return  quarterSin(x);
+    case 1:  return  quarterSin(1024 - x);
+    case 2:  return -quarterSin(x);
+    default: return -quarterSin(1024 - x);
+  }
+}
+
+int16_t   A1335Fixed::cosQ15(uint16_t raw){
+  return sinQ15(raw + 1024);                // cos(a) = sin(a + 90 deg)
+}
+
+void      A1335Fixed::sinCosQ15(uint16_t raw, int16_t& s, int16_t& c){
+  s = sinQ15(raw);
+  c = cosQ15(raw);
+}
@@ -0,0 +1,41 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Fixed point conversions of the raw sensor values, integer
+  math only so they are cheap on chips without FPU.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335FIXED_H
+#define A1335FIXED_H
+
+#if (ARDUINO >= 100)
+     #include "Arduino.h"
+#else
+     #include "WProgram.h"
+#endif
+
+class A1335Fixed {
+public:
+  // raw angle (4096 = 360 deg) to ...
+  static constexpr uint16_t angleQ16(uint16_t raw)       { return raw << 4; }                            // turns, 65536 = 360 deg
+  static constexpr uint16_t angleCentideg(uint16_t raw)  { return (uint32_t(raw) * 1125 + 64) >> 7; }    // 1/100 deg, 36000 / 4096 = 1125 / 128
+  static constexpr uint16_t angleMilliRad(uint16_t raw)  { return (uint32_t(raw) * 6283 + 2048) >> 12; } // 1/1000 rad, 2000 pi / 4096 ~ 6283 / 4096
+
+  // raw temperature (8 = 1 K) to ...
+  static constexpr uint16_t tempCentiK(uint16_t raw)     { return (uint32_t(raw) * 25) >> 1; }          // 1/100 K
+  static constexpr int16_t  tempCentiC(uint16_t raw)     { return int16_t(int32_t(tempCentiK(raw)) - 27315); } // 1/100 deg C
+
+  // raw field strength (1 = 1 G) to ...
+  static constexpr uint32_t fieldMicroTesla(uint16_t raw){ return uint32_t(raw) * 100; }                // uT
+
+  // sin / cos of a raw angle in Q15 (32767 = 1.0), from a quarter wave table with interpolation
+  static int16_t  sinQ15(uint16_t raw);
+  static int16_t  cosQ15(uint16_t raw);
+  static void     sinCosQ15(uint16_t raw, int16_t& s, int16_t& c);
+
+private:
+  static int16_t  quarterSin(uint16_t x);
+};
+
+#endif //A1335FIXED_H
@@ -0,0 +1,56 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Batch decoding of raw register frames
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Frame.h"
+
+using namespace A1335Reg;
+
+void      A1335Frame::angles(const byte* frames, byte n, uint16_t* angle){
+  for (byte i = 0; i < n; i++){
+    angle[i] = ANG_ANGLE::get(word(frames + i * A1335_FRAME_SIZE, ANG_OFFSET));
+  }
+}
+
+void      A1335Frame::temps(const byte* frames, byte n, uint16_t* temp){
+  for (byte i = 0; i < n; i++){
+    temp[i] = TSEN_TEMP::get(word(frames + i * A1335_FRAME_SIZE, TSEN_OFFSET));
+  }
+}
+
+void      A1335Frame::fields(const byte* frames, byte n, uint16_t* field){
+  for (byte i = 0; i < n; i++){
+    field[i] = FIELD_FIELD::get(word(frames + i * A1335_FRAME_SIZE, FIELD_OFFSET));
+  }
+}
+
+void      A1335Frame::flags(const byte* frames, byte n, byte* status){  // same bits as A1335Snapshot::status, without branches
+  for (byte i = 0; i < n; i++){
+    uint16_t ang = word(frames + i * A1335_FRAME_SIZE, ANG_OFFSET);
+    uint16_t parity = ang ^ (ang >> 8);
+    parity ^= parity >> 4;
+    parity ^= parity >> 2;
+    parity ^= parity >> 1;                // odd parity: bit 0 is 1 if the register is ok
+    status[i] = byte(ANG_NEW::get(ang) * A1335_STATUS_NEW   |
+                     ANG_EF::get(ang)  * A1335_STATUS_ERROR |
+                     (~parity & 1)     * A1335_STATUS_PARITY);
+  }
+}
+
+void      A1335Frame::decode(const byte* frames, byte n, uint16_t* angle, uint16_t* temp, uint16_t* field, byte* status){
+  if (angle) {
+    angles(frames, n, angle);
+  }
+  if (temp) {
+    temps(frames, n, temp);
+  }
+  if (field) {
+    fields(frames, n, field);
+  }
+  if (status) {
+    flags(frames, n, status);
+  }
+}
@@ -0,0 +1,37 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Batch decoding of raw register frames as written by
+  A1335::readFrame() and A1335Bus::updateFrames() into
+  separate columns. Every loop has a fixed stride and no
+  branches, so the compiler can unroll or vectorize it.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335FRAME_H
+#define A1335FRAME_H
+
+#include "A1335.h"
+
+class A1335Frame {
+public:
+  // byte offsets of the registers inside a frame, each MSB first
+  static const byte ANG_OFFSET   = 0;
+  static const byte STA_OFFSET   = 2;
+  static const byte ERR_OFFSET   = 4;
+  static const byte XERR_OFFSET  = 6;
+  static const byte TSEN_OFFSET  = 8;
+  static const byte FIELD_OFFSET = 10;
+
+  static uint16_t word(const byte* frame, byte offset) { return load_be16(frame + offset); }
+
+  static void angles(const byte* frames, byte n, uint16_t* angle);  // raw angles (4096 = 360 deg)
+  static void temps(const byte* frames, byte n, uint16_t* temp);    // raw temperatures (8 = 1 K)
+  static void fields(const byte* frames, byte n, uint16_t* field);  // raw field strengths (1 = 1 G)
+  static void flags(const byte* frames, byte n, byte* status);      // A1335_STATUS_NEW, _ERROR and _PARITY of each angle
+
+  static void decode(const byte* frames, byte n, uint16_t* angle, uint16_t* temp, uint16_t* field, byte* status);
+                                        // all of the above, columns that are nullptr are skipped
+};
+
+#endif //A1335FRAME_H
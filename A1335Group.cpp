@@ -0,0 +1,146 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Acquisition group over several buses
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Group.h"
+
+A1335Group::A1335Group(){
+
+}
+
+byte      A1335Group::add(A1335Bus& bus){
+  if (count >= A1335_GROUP_MAX_BUSES) {
+    return 0xFF;
+  }
+#if A1335_RTOS
+  if (running) {
+    return 0xFF;                        // the new bus would have no task, stop() first
+  }
+#endif
+  Lane& lane = lanes[count];
+  lane.bus   = &bus;
+  lane.start = 0;
+  lane.end   = 0;
+  lane.count = 0;
+#if A1335_RTOS
+  lane.group = this;
+  lane.task  = nullptr;
+#endif
+  return count++;
+}
+
+#if A1335_RTOS
+bool      A1335Group::begin(UBaseType_t priority, uint32_t stack){
+  if (running) {
+    return true;
+  }
+  if (!done) {
+    done = xSemaphoreCreateCounting(A1335_GROUP_MAX_BUSES, 0);
+    if (!done) {
+      return false;
+    }
+  }
+  stopping = false;
+  for (byte i = 0; i < count; i++){
+    if (xTaskCreate(run, "A1335Group", stack, &lanes[i], priority, &lanes[i].task) != pdPASS) {
+      stop();
+      return false;
+    }
+    running++;
+  }
+  return true;
+}
+
+void      A1335Group::stop(){
+  stopping = true;
+  for (byte i = 0; i < running; i++){
+    xTaskNotifyGive(lanes[i].task);
+  }
+  for (byte i = 0; i < running; i++){
+    xSemaphoreTake(done, portMAX_DELAY);  // every task gives once more before it ends
+  }
+  running = 0;
+}
+
+void      A1335Group::run(void* arg){
+  Lane& lane = *static_cast<Lane*>(arg);
+  A1335Group& group = *lane.group;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (group.stopping) {
+      break;
+    }
+    group.cycle(lane);
+    xSemaphoreGive(group.done);
+  }
+  lane.task = nullptr;
+  xSemaphoreGive(group.done);
+  vTaskDelete(nullptr);
+}
+#endif
+
+byte      A1335Group::update(){             // all lanes start together, the cycle ends with the slowest bus
+  startTime = micros();
+#if A1335_RTOS
+  if (running) {
+    for (byte i = 0; i < running; i++){
+      xTaskNotifyGive(lanes[i].task);
+    }
+    for (byte i = 0; i < running; i++){
+      xSemaphoreTake(done, portMAX_DELAY);
+    }
+  } else
+#endif
+  {
+    for (byte i = 0; i < count; i++){
+      cycle(lanes[i]);
+    }
+  }
+  byte n = 0;
+  for (byte i = 0; i < count; i++){
+    n += lanes[i].count;
+  }
+  cycleCount++;
+  return n;
+}
+
+void      A1335Group::cycle(Lane& lane){
+  lane.start = micros();
+  lane.count = lane.bus->update();
+  lane.end   = micros();
+}
+
+uint32_t  A1335Group::time(){
+  return startTime;
+}
+
+uint32_t  A1335Group::started(byte bus){
+  return bus < count ? lanes[bus].start : 0;
+}
+
+uint32_t  A1335Group::finished(byte bus){
+  return bus < count ? lanes[bus].end : 0;
+}
+
+const A1335Sample* A1335Group::samples(byte bus){
+  return bus < count ? lanes[bus].bus->samples() : nullptr;
+}
+
+byte      A1335Group::sampleCount(byte bus){
+  return bus < count ? lanes[bus].count : 0;
+}
+
+byte      A1335Group::busCount(){
+  return count;
+}
+
+A1335Bus& A1335Group::bus(byte index){
+  return *lanes[index].bus;
+}
+
+uint32_t  A1335Group::cycles(){
+  return cycleCount;
+}
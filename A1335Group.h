@@ -0,0 +1,76 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Acquisition group: one cycle on several buses (Wire, Wire1,
+  ...) at once, the results aligned to a common cycle start
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335GROUP_H
+#define A1335GROUP_H
+
+#include "A1335Bus.h"
+#if A1335_RTOS
+#include "A1335Rtos.h"
+#endif
+
+#ifndef A1335_GROUP_MAX_BUSES
+#define A1335_GROUP_MAX_BUSES 4                 // buses per group, can be overridden before including this file
+#endif
+
+class A1335Group {      // every bus has to be its own controller, sensors sharing one belong in the same A1335Bus
+public:
+  A1335Group();
+
+  byte      add(A1335Bus& bus);         // adds a bus. Returns the index of the bus or 0xFF if the group is full
+                                        // or its tasks are running
+
+#if A1335_RTOS
+  bool      begin(UBaseType_t priority = 3, uint32_t stack = 2048);
+                                        // starts one task per bus, from now on update() cycles all buses in parallel.
+                                        // stack in the units of xTaskCreate(). Returns false if a task could not be created
+  void      stop();                     // ends the tasks, update() reads the buses one after the other again
+#endif
+
+  byte      update();                   // one cycle on every bus, returns when all are done. Without begin() the
+                                        // buses are read one after the other. Returns the number of new samples
+
+  uint32_t  time();                     // micros() at the start of the last cycle, common to all buses
+  uint32_t  started(byte bus);          // micros() when the bus started its part of the last cycle
+  uint32_t  finished(byte bus);         // micros() when the bus finished it
+  const A1335Sample* samples(byte bus); // samples of the bus in the last cycle, sensor = index on that bus
+  byte      sampleCount(byte bus);
+
+  byte      busCount();
+  A1335Bus& bus(byte index);
+  uint32_t  cycles();                   // number of update() calls so far
+
+private:
+  struct Lane {
+    A1335Bus* bus;
+    uint32_t  start;
+    uint32_t  end;
+    byte      count;                    // samples of the last cycle
+#if A1335_RTOS
+    A1335Group*  group;
+    TaskHandle_t task;
+#endif
+  };
+
+  void      cycle(Lane& lane);
+#if A1335_RTOS
+  static void run(void* lane);
+#endif
+
+  Lane      lanes[A1335_GROUP_MAX_BUSES];
+  uint32_t  startTime = 0;
+  uint32_t  cycleCount = 0;
+  byte      count = 0;
+#if A1335_RTOS
+  SemaphoreHandle_t done = nullptr;     // given by every lane at the end of its cycle
+  byte      running = 0;                // number of lane tasks
+  volatile bool stopping = false;
+#endif
+};
+
+#endif //A1335GROUP_H
@@ -0,0 +1,157 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Compact binary log of A1335Samples
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Log.h"
+
+static void store_le16(byte* p, uint16_t v){
+  p[0] = byte(v);
+  p[1] = byte(v >> 8);
+}
+
+static void store_le32(byte* p, uint32_t v){
+  store_le16(p, uint16_t(v));
+  store_le16(p + 2, uint16_t(v >> 16));
+}
+
+A1335LogWriter::A1335LogWriter(Print& out_, byte sensors_, uint16_t blockSize_, uint16_t sideEvery_) :
+  out(&out_), blockSize(blockSize_ < 64 ? 64 : blockSize_), sideEvery(sideEvery_),
+  sensors(sensors_ > A1335_LOG_MAX_SENSORS ? A1335_LOG_MAX_SENSORS : sensors_){
+
+}
+
+size_t    A1335LogWriter::cycle(const A1335Sample* samples, byte n){  // the common case costs 3 + 1 byte per sensor
+  if (n == 0) {
+    return 0;
+  }
+  size_t total = 0;
+  uint32_t time = samples[0].time;
+  if (used == 0) {
+    total += header(time);
+  }
+  const A1335Sample* bySensor[A1335_LOG_MAX_SENSORS] = {};
+  byte mask = 0;
+  for (byte i = 0; i < n; i++){
+    if (samples[i].sensor < sensors) {
+      bySensor[samples[i].sensor] = &samples[i];
+      mask |= 1 << samples[i].sensor;
+    }
+  }
+
+  byte record[6 + 2 * A1335_LOG_MAX_SENSORS];
+  byte length;
+  uint32_t dt = time - lastTime;
+  if (dt <= 0xFF) {
+    record[0] = A1335_LOG_CYCLE8;
+    record[1] = byte(dt);
+    length = 2;
+  } else if (dt <= 0xFFFF) {
+    record[0] = A1335_LOG_CYCLE16;
+    store_le16(record + 1, uint16_t(dt));
+    length = 3;
+  } else {
+    record[0] = A1335_LOG_CYCLE32;
+    store_le32(record + 1, dt);
+    length = 5;
+  }
+  record[length++] = mask;
+
+  if (used + length + 2 * n > blockSize) {
+    total += flush();                   // the codes depend on the block, so start it before encoding
+    total += header(time);
+    record[1] = 0;                      // dt = 0 after the new header
+    record[0] = A1335_LOG_CYCLE8;
+    record[2] = mask;
+    length = 3;
+  }
+
+  for (byte s = 0; s < sensors; s++){
+    const A1335Sample* sample = bySensor[s];
+    if (!sample) {
+      continue;
+    }
+    uint16_t angle = sample->angle & 0x0FFF;
+    byte flags = sample->flags;
+    int16_t delta = int16_t(((angle - last[s] + 2048) & 0x0FFF)) - 2048;
+    bool seen = known & (1 << s);
+    if (seen && flags == A1335_STATUS_NEW && delta >= -32 && delta < 32) {
+      record[length++] = byte(delta & 0x3F);
+    } else if (seen && flags == 0 && delta == 0) {
+      record[length++] = A1335_LOG_STALE;
+    } else {
+      record[length++] = 0x80 | (flags & A1335_STATUS_NEW     ? 0x40 : 0) |
+                                (flags & A1335_STATUS_ERROR   ? 0x20 : 0) |
+                                (flags & A1335_STATUS_INVALID ? 0x10 : 0) | byte(angle >> 8);
+      record[length++] = byte(angle);
+    }
+    last[s] = angle;
+    known |= 1 << s;
+  }
+  lastTime = time;
+  sideCount++;
+  return total + emit(record, length);
+}
+
+size_t    A1335LogWriter::side(byte sensor, uint16_t temp, uint16_t field){
+  byte record[6] = { A1335_LOG_SIDE, sensor };
+  store_le16(record + 2, temp);
+  store_le16(record + 4, field);
+  sideCount = 0;
+  return emit(record, sizeof(record));
+}
+
+bool      A1335LogWriter::sideDue(){
+  return sideEvery && sideCount >= sideEvery;
+}
+
+size_t    A1335LogWriter::flush(){          // fills the block with padding
+  if (used == 0) {
+    return 0;
+  }
+  byte pad[16] = {};
+  size_t total = 0;
+  while (used < blockSize) {
+    byte n = blockSize - used < uint16_t(sizeof(pad)) ? blockSize - used : sizeof(pad);
+    total += out->write(pad, n);
+    used += n;
+  }
+  written += total;
+  used = 0;
+  return total;
+}
+
+uint32_t  A1335LogWriter::bytes(){
+  return written;
+}
+
+uint32_t  A1335LogWriter::blocks(){
+  return sequence;
+}
+
+size_t    A1335LogWriter::emit(const byte* data, byte length){
+  size_t total = 0;
+  if (used == 0 || used + length > blockSize) {
+    total += flush();
+    total += header(lastTime);
+  }
+  size_t n = out->write(data, length);
+  used += length;
+  written += n;
+  return total + n;
+}
+
+size_t    A1335LogWriter::header(uint32_t time){  // opens a block, angles are sent in full again
+  byte record[A1335_LOG_HEADER_SIZE] = { 0xA1, 0x35, A1335_LOG_VERSION, sensors };
+  store_le16(record + 4, blockSize);
+  store_le32(record + 6, sequence++);
+  store_le32(record + 10, time);
+  size_t n = out->write(record, sizeof(record));
+  used = A1335_LOG_HEADER_SIZE;
+  written += n;
+  lastTime = time;
+  known = 0;
+  return n;
+}
@@ -0,0 +1,76 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Compact binary log of A1335Samples for long, fast captures
+  to SD cards or a serial port. extras/A1335LogDecode.cpp reads
+  it back on a PC.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335LOG_H
+#define A1335LOG_H
+
+#include "A1335.h"
+
+// Format, all multi byte numbers little endian:
+//
+// The log is a row of blocks of blockSize bytes, so block k starts at k * blockSize and a reader
+// can seek by time without parsing what is in front. Every block starts with a header:
+//   0xA1 0x35  version  sensors  blockSize(2)  sequence(4)  time(4)       14 bytes, time in us
+// followed by records. The angles in a block do not depend on earlier blocks.
+//   0x00                                       padding up to the end of the block
+//   0x01 dt(1) | 0x02 dt(2) | 0x04 dt(4)       cycle, dt in us since the previous cycle (the header for the first one),
+//     mask(1)  code ...                        then one code per set bit of mask, lowest sensor first
+//   0x10 sensor temp(2) field(2)               raw TSEN and FIELD values of a sensor
+//
+// Angle codes, delta = angle - previous angle of the sensor, wrapped to -2048..2047:
+//   00dddddd                                   new, valid angle, delta -32..31
+//   01000000                                   stale angle: same value, NEW flag not set
+//   1nei aaaa aaaaaaaa                         any other angle: n = new, e = error flag, i = parity or bus error
+//                                              and the 12 bit angle. The first angle of a sensor in a block is always like this
+
+const byte     A1335_LOG_VERSION       = 1;
+const byte     A1335_LOG_MAX_SENSORS   = 8;     // one bit each in the cycle mask
+const byte     A1335_LOG_HEADER_SIZE   = 14;
+
+const byte     A1335_LOG_PAD           = 0x00;
+const byte     A1335_LOG_CYCLE8        = 0x01;
+const byte     A1335_LOG_CYCLE16       = 0x02;
+const byte     A1335_LOG_CYCLE32       = 0x04;
+const byte     A1335_LOG_SIDE          = 0x10;
+
+const byte     A1335_LOG_STALE         = 0x40;
+
+class A1335LogWriter {
+public:
+  A1335LogWriter(Print& out_, byte sensors_, uint16_t blockSize_ = 512, uint16_t sideEvery_ = 1000);
+                                        // sensors = number of sensor indices used (at most 8), blockSize at least 64,
+                                        // 512 matches the sectors of an SD card
+
+  size_t    cycle(const A1335Sample* samples, byte n); // logs one bus cycle, e.g. bus.samples(). The time of the
+                                        // cycle is the time of its first sample. Returns the bytes written
+  size_t    side(byte sensor, uint16_t temp, uint16_t field); // logs raw temperature and field of a sensor
+  bool      sideDue();                  // true every sideEvery cycles, time to read TSEN / FIELD and call side()
+  size_t    flush();                    // pads the current block, the next record starts a new one
+
+  uint32_t  bytes();                    // bytes written so far
+  uint32_t  blocks();                   // blocks started so far
+
+private:
+  size_t    emit(const byte* data, byte length); // writes a record, starts a new block if it does not fit
+  size_t    header(uint32_t time);
+
+  Print*    out;
+  uint32_t  lastTime = 0;               // time of the previous cycle or block header
+  uint32_t  written = 0;
+  uint32_t  sequence = 0;
+  uint16_t  blockSize;
+  uint16_t  used = 0;                   // bytes used in the current block, 0 = no block open
+  uint16_t  sideEvery;
+  uint16_t  sideCount = 0;
+  uint16_t  last[A1335_LOG_MAX_SENSORS];// previous angle per sensor
+  byte      known = 0;                  // bit per sensor: last[] is valid in the current block
+  byte      sensors;
+};
+
+#endif //A1335LOG_H
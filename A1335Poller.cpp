@@ -0,0 +1,142 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Adaptive polling: reads a sensor only when a new angle is due,
+  learning the real update period and phase from the NEW flag,
+  or reading on an external data ready interrupt.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Poller.h"
+
+const byte PERIOD_SHIFT = 3;            // the estimate follows each measurement by 1/8
+const byte RETRY_SHIFT  = 4;            // a stale read is retried after 1/16 of the period
+const byte LEAD_SHIFT   = 5;            // reads are aimed 1/32 period after the expected update
+const byte PULL_SHIFT   = 4;            // every hit at the first try aims the next read 1/16 period earlier
+
+A1335Poller::A1335Poller(A1335& sensor_, byte index_) : sensor(&sensor_), index(index_){
+
+}
+
+void      A1335Poller::begin(){
+  periodUs = sensor->getSamplePeriod();
+  nextRead = micros();
+  haveNew  = false;
+  haveEdge = false;
+  missed   = false;
+  hits     = 0;
+}
+
+bool      A1335Poller::update(A1335Sample& sample){  // reads if due and locks onto the update clock of the sensor
+  uint32_t now = micros();
+  bool due = int32_t(now - nextRead) >= 0;
+  if (external) {
+    bool fired = false;
+    if (triggered) {                    // cleared only when seen set, a trigger() in between is never lost
+      noInterrupts();
+      fired = triggered;
+      triggered = false;
+      interrupts();
+    }
+    due = fired || (missed && due);     // one retry if the trigger came before the angle
+  }
+  if (!due) {
+    return false;                       // no new angle expected yet
+  }
+  readCount++;
+  if (!sensor->readAngleIfNew(sample, index)) {
+    staleCount++;
+    if (!(sample.flags & A1335_STATUS_INVALID)) {
+      lastStale = sample.time;          // a valid stale read: the update is still to come
+      missed = !external || !missed;  // with a trigger only one retry per trigger
+    }
+    nextRead = sample.time + (periodUs >> RETRY_SHIFT) + 1;
+    return false;
+  }
+
+  uint32_t t = sample.time;
+  if (haveNew && missed) {              // the update happened between the stale read and this one
+    uint32_t measured = lastStale + ((t - lastStale) >> 1);
+    if (haveEdge) {
+      uint32_t elapsed = measured - lastMeasured;
+      uint32_t periods = (elapsed + (periodUs >> 1)) / periodUs;  // updates since the last measurement, some may be skipped
+      if (periods) {
+        int32_t error = int32_t(elapsed - periods * periodUs) / int32_t(periods);
+        periodUs += error >> PERIOD_SHIFT;
+      }
+    }
+    lastMeasured = measured;
+    haveEdge = true;
+    edge = measured;
+    hits = 0;
+  } else if (haveNew) {                 // found at the first try: the update was earlier, predict it from the last one
+    uint32_t periods = (t - edge) / periodUs;
+    uint32_t predicted = edge + (periods ? periods : 1) * periodUs;
+    if (int32_t(predicted - t) > 0) {
+      predicted = t;                    // the update cannot be later than the read that found it
+    }
+    edge = predicted;
+    if (hits < 0xFF) {
+      hits++;
+    }
+  } else {
+    edge = t;                           // first angle, the update was some time before
+  }
+  if (periodUs == 0) {
+    periodUs = 1;
+  }
+  missed   = false;
+  lastNew  = t;
+  haveNew  = true;
+  uint32_t pull = hits * (periodUs >> PULL_SHIFT);  // without a stale read the phase is not checked, so every hit aims earlier
+  if (pull > periodUs >> 1) {
+    pull = periodUs >> 1;
+  }
+  nextRead = edge + periodUs + (periodUs >> LEAD_SHIFT) + 1 - pull;
+#if A1335_TIMESTAMPS
+  sample.stamps.update = edge;
+#endif
+#if A1335_HEALTH
+  if (housekeepingEvery && ++housekeepingCount >= housekeepingEvery) {
+    housekeepingCount = 0;
+    sensor->housekeeping();             // right after an update the bus is idle for most of a period
+  }
+#endif
+  return true;
+}
+
+void      A1335Poller::useTrigger(bool enable){
+  external  = enable;
+  triggered = false;
+}
+
+void      A1335Poller::trigger(){
+  triggered = true;
+}
+
+#if A1335_HEALTH
+void      A1335Poller::setHousekeeping(byte every){
+  housekeepingEvery = every;
+  housekeepingCount = 0;
+}
+#endif
+
+uint32_t  A1335Poller::period(){
+  return periodUs;
+}
+
+uint32_t  A1335Poller::lastUpdate(){
+  return edge;
+}
+
+uint32_t  A1335Poller::latency(){
+  return lastNew - edge;
+}
+
+uint32_t  A1335Poller::reads(){
+  return readCount;
+}
+
+uint32_t  A1335Poller::staleReads(){
+  return staleCount;
+}
@@ -0,0 +1,62 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Adaptive polling: reads a sensor only when a new angle is due,
+  learning the real update period and phase from the NEW flag,
+  or reading on an external data ready interrupt.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335POLLER_H
+#define A1335POLLER_H
+
+#include "A1335.h"
+
+class A1335Poller {
+public:
+  A1335Poller(A1335& sensor_, byte index_ = 0);
+
+  void      begin();                    // starts with the period given by the output rate of the sensor
+
+  bool      update(A1335Sample& sample);// call as often as possible. Reads only when due, true if sample holds a new angle
+
+  void      useTrigger(bool enable);    // true: read only after trigger(), e.g. from a data ready or timer interrupt
+  void      trigger();                  // marks a new angle as ready, safe to call from an interrupt handler:
+                                        // void onReady() { poller.trigger(); }
+                                        // attachInterrupt(digitalPinToInterrupt(pin), onReady, RISING);
+
+#if A1335_HEALTH
+  void      setHousekeeping(byte every);// every n-th new angle is followed by one sensor.housekeeping() read, in the
+                                        // idle time before the next angle is due. 0 = never (default)
+#endif
+
+  uint32_t  period();                   // learned time between new angles in us
+  uint32_t  lastUpdate();               // estimated micros() at which the sensor produced the last new angle
+  uint32_t  latency();                  // time from that update to the end of its read in us
+  uint32_t  reads();                    // reads done so far
+  uint32_t  staleReads();               // reads that found no new angle
+
+private:
+  A1335*    sensor;
+  byte      index;
+  uint32_t  periodUs = 0;               // estimated update period
+  uint32_t  edge = 0;                   // estimated micros() of the last update inside the sensor
+  uint32_t  lastMeasured = 0;           // last update time found between a stale and a new read
+  uint32_t  lastNew = 0;                // micros() of the last new angle
+  uint32_t  lastStale = 0;              // micros() of the last read that found no new angle
+  uint32_t  nextRead = 0;               // micros() of the next read
+  bool      haveNew = false;            // edge and lastNew are valid
+  bool      haveEdge = false;           // lastMeasured is valid
+  byte      hits = 0;                   // new angles found at the first try since lastMeasured
+#if A1335_HEALTH
+  byte      housekeepingEvery = 0;
+  byte      housekeepingCount = 0;
+#endif
+  bool      missed = false;             // there was a stale read since the last new angle
+  bool      external = false;           // reads are started by trigger()
+  volatile bool triggered = false;
+  uint32_t  readCount = 0;
+  uint32_t  staleCount = 0;
+};
+
+#endif //A1335POLLER_H
@@ -0,0 +1,81 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Latency histograms
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Profiler.h"
+
+#if A1335_TIMESTAMPS
+
+const char* const A1335StageNames[A1335_STAGES] = { "wait", "bus", "decode", "queue", "age" };
+
+void      A1335Histogram::add(uint32_t us){
+  byte k = 0;
+  for (uint32_t v = us; v && k < A1335_HISTOGRAM_BINS - 1; v >>= 1){
+    k++;
+  }
+  bins[k]++;
+  n++;
+  sum += us;
+  if (us > longest) {
+    longest = us;
+  }
+}
+
+void      A1335Histogram::reset(){
+  memset(bins, 0, sizeof(bins));
+  n       = 0;
+  sum     = 0;
+  longest = 0;
+}
+
+uint32_t  A1335Histogram::count() const {
+  return n;
+}
+
+uint32_t  A1335Histogram::bin(byte k) const {
+  return k < A1335_HISTOGRAM_BINS ? bins[k] : 0;
+}
+
+uint32_t  A1335Histogram::mean() const {
+  return n ? sum / n : 0;
+}
+
+uint32_t  A1335Histogram::max() const {
+  return longest;
+}
+
+uint32_t  A1335Histogram::percentile(byte p) const {
+  if (n == 0) {
+    return 0;
+  }
+  uint32_t target = uint32_t((uint64_t(n) * (p > 100 ? 100 : p) + 99) / 100);  // rounded up, at least the first sample
+  uint32_t seen = 0;
+  for (byte k = 0; k < A1335_HISTOGRAM_BINS - 1; k++){
+    seen += bins[k];
+    if (seen >= target && seen) {
+      uint32_t top = (uint32_t(1) << k) - 1;
+      return top < longest ? top : longest;
+    }
+  }
+  return longest;                       // the open last bin
+}
+
+void      A1335Histogram::print(Print& out, const char* name) const {
+  out.print(name);
+  out.print(": n=");
+  out.print(n);
+  out.print(" mean=");
+  out.print(mean());
+  out.print(" p50<=");
+  out.print(percentile(50));
+  out.print(" p99<=");
+  out.print(percentile(99));
+  out.print(" max=");
+  out.print(longest);
+  out.println(" us");
+}
+
+#endif //A1335_TIMESTAMPS
@@ -0,0 +1,131 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Latency profiler: histograms of the time a sample spends in
+  each stage of the read path, per sensor and per bus, from the
+  stamps of A1335_TIMESTAMPS.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335PROFILER_H
+#define A1335PROFILER_H
+
+#include "A1335.h"
+
+#if A1335_TIMESTAMPS
+
+// Stages of one sample, each measured between two of its A1335Stamps:
+enum A1335Stage : byte {
+  A1335_STAGE_WAIT,             // update in the sensor -> start of the transfer (only with A1335Poller)
+  A1335_STAGE_BUS,              // start -> end of the transfer
+  A1335_STAGE_DECODE,           // end of the transfer -> angle decoded
+  A1335_STAGE_QUEUE,            // pushed -> popped (A1335Ring or A1335Latest)
+  A1335_STAGE_AGE,              // update (or start of the transfer if unknown) -> popped (or decoded): the age
+                                // of the angle when the control loop gets it
+  A1335_STAGES
+};
+
+const byte     A1335_HISTOGRAM_BINS    = 16;    // bin 0: 0 us, bin k: 2^(k-1) .. 2^k - 1 us, the last bin from 16384 us up
+
+class A1335Histogram {  // durations in log2 bins, 76 bytes
+public:
+  void      add(uint32_t us);
+  void      reset();
+
+  uint32_t  count() const;              // durations added
+  uint32_t  bin(byte k) const;          // durations in bin k
+  uint32_t  mean() const;               // in us
+  uint32_t  max() const;                // longest duration in us
+  uint32_t  percentile(byte p) const;   // upper end of the bin that holds the p-th percentile, in us. A budget is met
+                                        // p % of the time if this is below it
+
+  void      print(Print& out, const char* name) const; // one line: name, count, mean, p50, p99, max
+
+private:
+  uint32_t  bins[A1335_HISTOGRAM_BINS] = {};
+  uint32_t  n = 0;
+  uint32_t  sum = 0;                    // wraps after 2^32 us in total (71 minutes), mean() is wrong after that
+  uint32_t  longest = 0;
+};
+
+extern const char* const A1335StageNames[A1335_STAGES];
+
+// One histogram per stage for every sensor index (A1335Sample::sensor) and every bus.
+// Feed it the samples the control loop consumed, e.g. after A1335Ring::popBatch().
+
+template <byte Sensors, byte Buses = 1>
+class A1335Profiler {
+public:
+  void      add(const A1335Sample& sample, byte bus = 0){  // records the stages the sample passed
+    const A1335Stamps& s = sample.stamps;
+    uint32_t begin = s.update ? s.update : s.request;
+    uint32_t end   = s.popped ? s.popped : s.decoded;
+    record(sample.sensor, bus, A1335_STAGE_WAIT,   s.update,  s.request);
+    record(sample.sensor, bus, A1335_STAGE_BUS,    s.request, sample.time);
+    record(sample.sensor, bus, A1335_STAGE_DECODE, sample.time, s.decoded);
+    record(sample.sensor, bus, A1335_STAGE_QUEUE,  s.pushed,  s.popped);
+    record(sample.sensor, bus, A1335_STAGE_AGE,    begin,     end);
+  }
+
+  void      add(const A1335Sample* samples, byte n, byte bus = 0){  // a batch, e.g. bus.samples() or popBatch()
+    for (byte i = 0; i < n; i++){
+      add(samples[i], bus);
+    }
+  }
+
+  const A1335Histogram& sensor(byte index, A1335Stage stage) const { return bySensor[index < Sensors ? index : 0][stage]; }
+  const A1335Histogram& bus(byte index, A1335Stage stage) const { return byBus[index < Buses ? index : 0][stage]; }
+
+  void      reset(){
+    for (byte i = 0; i < Sensors; i++){
+      for (byte k = 0; k < A1335_STAGES; k++){
+        bySensor[i][k].reset();
+      }
+    }
+    for (byte i = 0; i < Buses; i++){
+      for (byte k = 0; k < A1335_STAGES; k++){
+        byBus[i][k].reset();
+      }
+    }
+  }
+
+  void      print(Print& out) const {   // all stages with samples, per sensor and per bus
+    for (byte i = 0; i < Sensors; i++){
+      printSet(out, "sensor ", i, bySensor[i]);
+    }
+    for (byte i = 0; i < Buses; i++){
+      printSet(out, "bus ", i, byBus[i]);
+    }
+  }
+
+private:
+  void      record(byte sensor, byte bus, byte stage, uint32_t from, uint32_t to){
+    if (!from || !to || sensor >= Sensors || bus >= Buses) {
+      return;                           // stage not passed
+    }
+    uint32_t us = to - from;
+    if (int32_t(us) < 0) {
+      us = 0;                           // an estimated update can lie after the read that found it
+    }
+    bySensor[sensor][stage].add(us);
+    byBus[bus][stage].add(us);
+  }
+
+  static void printSet(Print& out, const char* kind, byte index, const A1335Histogram* set){
+    for (byte k = 0; k < A1335_STAGES; k++){
+      if (set[k].count()) {
+        out.print(kind);
+        out.print(index);
+        out.print(" ");
+        set[k].print(out, A1335StageNames[k]);
+      }
+    }
+  }
+
+  A1335Histogram bySensor[Sensors][A1335_STAGES];
+  A1335Histogram byBus[Buses][A1335_STAGES];
+};
+
+#endif //A1335_TIMESTAMPS
+
+#endif //A1335PROFILER_H
@@ -0,0 +1,132 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Register map. Every field is a type, get() and set() compile
+  to one shift and one mask on the 16 bit register word.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335REGISTERS_H
+#define A1335REGISTERS_H
+
+#if (ARDUINO >= 100)
+     #include "Arduino.h"
+#else
+     #include "WProgram.h"
+#endif
+
+// Byte order: the sensor sends and expects every register MSB first. These helpers
+// build the words with shifts, so they do not depend on the byte order of the host.
+
+constexpr uint16_t load_be16(const byte* p) { return uint16_t((uint16_t(p[0]) << 8) | p[1]); }
+constexpr uint32_t load_be32(const byte* p) { return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+                                                     (uint32_t(p[2]) << 8)  |  uint32_t(p[3]); }
+
+inline void store_be16(byte* p, uint16_t value) {
+  p[0] = byte(value >> 8);
+  p[1] = byte(value);
+}
+
+inline void store_be32(byte* p, uint32_t value) {
+  store_be16(p, uint16_t(value >> 16));
+  store_be16(p + 2, uint16_t(value));
+}
+
+
+template <byte Reg, byte Shift, byte Width>
+struct A1335Field {     // Width bits starting at bit Shift of the 16 bit register at address Reg (MSB at Reg)
+  static constexpr byte     reg()   { return Reg; }
+  static constexpr uint16_t bits()  { return (1u << Width) - 1; }
+  static constexpr uint16_t mask()  { return bits() << Shift; }
+  static constexpr uint16_t get(uint16_t word)                 { return (word >> Shift) & bits(); }
+  static constexpr bool     test(uint16_t word)                { return word & mask(); }
+  static constexpr uint16_t set(uint16_t word, uint16_t value) { return (word & ~mask()) | ((value << Shift) & mask()); }
+};
+
+template <uint16_t Reg, byte Shift, byte Width>
+struct A1335ExtField {  // the same for a field of the 32 bit extended register at address Reg
+  static constexpr uint16_t reg()   { return Reg; }
+  static constexpr uint32_t bits()  { return (uint32_t(1) << Width) - 1; }
+  static constexpr uint32_t mask()  { return bits() << Shift; }
+  static constexpr uint32_t get(uint32_t word)                 { return (word >> Shift) & bits(); }
+  static constexpr uint32_t set(uint32_t word, uint32_t value) { return (word & ~mask()) | ((value << Shift) & mask()); }
+};
+
+namespace A1335Reg {
+
+//--- Normal Write Registers ---//
+
+constexpr byte EWA    = 0x02;   // Extended Write Address
+constexpr byte EWD    = 0x04;   // Extended Write Data
+constexpr byte EWCS   = 0x08;   // Extended Write Control and Status
+constexpr byte ERA    = 0x0A;   // Extended Read Address
+constexpr byte ERCS   = 0x0C;   // Extended Read Control and Status
+constexpr byte ERD    = 0x0E;   // Extended Read Data
+constexpr byte CTRL   = 0x1E;   // Device control
+constexpr byte ANG    = 0x20;   // Current angle and related data
+constexpr byte STA    = 0x22;   // Device status
+constexpr byte ERR    = 0x24;   // Device error status
+constexpr byte XERR   = 0x26;   // Extended error status
+constexpr byte TSEN   = 0x28;   // Temperature sensor data
+constexpr byte FIELD  = 0x2A;   // Magnetic field strength
+constexpr byte ERM    = 0x34;   // Device error status masking
+constexpr byte XERM   = 0x36;   // Extended error status masking
+
+//--- Extended Write Registers ---//
+
+constexpr uint16_t ORATE = 0xFFD0;  // Output Rate
+
+
+// Control words: CTRL(0x1E) in the high byte, KEY(0x1F) in the low byte
+
+constexpr uint16_t CTRL_IDLE  = 0x8046;  // Idle mode
+constexpr uint16_t CTRL_RUN   = 0xC046;  // Run  mode
+constexpr uint16_t CTRL_HRE   = 0x20B9;  // Hard reset
+constexpr uint16_t CTRL_SRE   = 0x10B9;  // Soft reset
+constexpr uint16_t CTRL_CSTA  = 0x0446;  // Clear (STA)  registers
+constexpr uint16_t CTRL_CXERR = 0x0246;  // Clear (XERR) registers
+constexpr uint16_t CTRL_CERR  = 0x0146;  // Clear (ERR)  registers
+
+
+// Angle register ANG (0x20)
+
+typedef A1335Field<ANG, 15, 1>  ANG_RIDC;     // Register Identifier Code, always 0
+typedef A1335Field<ANG, 14, 1>  ANG_EF;       // At least one error in register 0x24
+typedef A1335Field<ANG, 13, 1>  ANG_NEW;      // A new angle is in the angle register
+typedef A1335Field<ANG, 12, 1>  ANG_PAR;      // Odd parity bit for the whole register
+typedef A1335Field<ANG,  0, 12> ANG_ANGLE;    // Encoded angle reading (n * 360/4096 = angle in deg.)
+
+// Status register STA (0x22)
+
+typedef A1335Field<STA, 12, 4>  STA_RIDC;     // Register Identifier Code, always 1000
+typedef A1335Field<STA, 11, 1>  STA_POR;      // There was a power-on reset since last field reset
+typedef A1335Field<STA, 10, 1>  STA_SRF;      // There was a soft reset since last field reset
+typedef A1335Field<STA,  9, 1>  STA_NEW;      // A new angle is in the angle register
+typedef A1335Field<STA,  8, 1>  STA_EF;       // At least one error in register 0x24
+typedef A1335Field<STA,  4, 4>  STA_MPS;      // 0000 Booting; 0001 Idle or Processing angles; 1110 Self-testmode
+typedef A1335Field<STA,  0, 4>  STA_PHASE;    // 0000 Idle; 0001 Processing angles; Only in Self-test mode [0100 Built in self test; 0110 ROM checksum; 0111 CVH self test]
+
+// Error registers ERR (0x24) and XERR (0x26), a set bit is an active error unless masked in ERM / XERM
+
+typedef A1335Field<ERR, 12, 4>  ERR_RIDC;     // Register Identifier Code
+typedef A1335Field<ERR,  0, 12> ERR_FLAGS;    // Device error flags
+typedef A1335Field<XERR, 12, 4> XERR_RIDC;    // Register Identifier Code
+typedef A1335Field<XERR, 0, 12> XERR_FLAGS;   // Extended error flags
+
+// Temperature register TSEN (0x28)
+
+typedef A1335Field<TSEN, 12, 4> TSEN_RIDC;    // Register Identifier Code, always 1111
+typedef A1335Field<TSEN,  0, 12> TSEN_TEMP;   // Encoded temperature reading (n / 8 = temperature in K)
+
+// Output rate ORATE (0xFFD0). The extended read returns the word MSB first, the rate is in its lowest bits
+
+typedef A1335ExtField<ORATE, 0, 3> ORATE_RATE;  // log2() of the number of samples averaged per angle
+
+// Field strength register FIELD (0x2A)
+
+typedef A1335Field<FIELD, 12, 4> FIELD_RIDC;  // Register Identifier Code, always 1110
+typedef A1335Field<FIELD,  0, 12> FIELD_FIELD;// Magnetic field strenght reading (n = field strenght in Gauss (1/10000 T))
+
+}  // namespace A1335Reg
+
+#endif //A1335REGISTERS_H
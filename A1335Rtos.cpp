@@ -0,0 +1,144 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  FreeRTOS support: locked transport and acquisition task
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Rtos.h"
+
+#if A1335_RTOS
+
+//--- Locked transport ---//
+
+A1335LockedTransport::A1335LockedTransport(A1335Transport& inner_) : inner(&inner_){
+  mutex = xSemaphoreCreateRecursiveMutex();
+}
+
+byte      A1335LockedTransport::probe(byte address){
+  A1335BusLock busLock(*this);
+  return inner->probe(address);
+}
+
+byte      A1335LockedTransport::write(byte address, byte reg, const byte* data, byte length){
+  A1335BusLock busLock(*this);
+  return inner->write(address, reg, data, length);
+}
+
+byte      A1335LockedTransport::select(byte address, byte reg){
+  A1335BusLock busLock(*this);
+  return inner->select(address, reg);
+}
+
+byte      A1335LockedTransport::receive(byte address, byte* data, byte length){
+  A1335BusLock busLock(*this);
+  return inner->receive(address, data, length);
+}
+
+byte      A1335LockedTransport::read(byte address, byte reg, byte* data, byte length){  // pointer and data in one hold
+  A1335BusLock busLock(*this);
+  return inner->read(address, reg, data, length);
+}
+
+void      A1335LockedTransport::lock(){
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+}
+
+void      A1335LockedTransport::unlock(){
+  xSemaphoreGiveRecursive(mutex);
+}
+
+
+//--- Acquisition task ---//
+
+A1335Worker::A1335Worker(A1335Bus& bus_) : bus(&bus_){
+
+}
+
+bool      A1335Worker::begin(uint32_t periodMs, UBaseType_t priority, uint32_t stack, const char* name){
+  if (task) {
+    return true;
+  }
+  period   = periodMs ? pdMS_TO_TICKS(periodMs) : 0;
+  if (periodMs && period == 0) {
+    period = 1;                         // at least one tick
+  }
+  stopping = false;
+  return xTaskCreate(run, name, stack, this, priority, &task) == pdPASS;
+}
+
+void      A1335Worker::stop(){
+  if (!task) {
+    return;
+  }
+  stopping = true;
+  xTaskNotifyGive(task);                // wakes a task waiting for notify()
+  while (task) {
+    vTaskDelay(1);
+  }
+}
+
+void      A1335Worker::notify(){
+  if (task) {
+    xTaskNotifyGive(task);
+  }
+}
+
+void      A1335Worker::notifyFromISR(){
+  if (task) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+#if defined(__AVR__)
+    if (woken) {
+      portYIELD_FROM_ISR();             // the AVR port takes no argument
+    }
+#else
+    portYIELD_FROM_ISR(woken);          // Cortex-M and ESP32 ports check the flag themselves
+#endif
+  }
+}
+
+bool      A1335Worker::latest(byte index, A1335Sample& sample){
+  if (index >= A1335_BUS_MAX_SENSORS) {
+    return false;
+  }
+  return latestSample[index].load(sample);
+}
+
+uint32_t  A1335Worker::cycles(){
+  return cycleCount;
+}
+
+TaskHandle_t A1335Worker::handle(){
+  return task;
+}
+
+void      A1335Worker::run(void* self){
+  static_cast<A1335Worker*>(self)->loop();
+}
+
+void      A1335Worker::loop(){                // the only writer of latestSample
+  TickType_t last = xTaskGetTickCount();
+  while (!stopping) {
+    if (period) {
+      vTaskDelayUntil(&last, period);
+    } else {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    if (stopping) {
+      break;
+    }
+    byte n = bus->update();
+    const A1335Sample* samples = bus->samples();
+    for (byte i = 0; i < n; i++){
+      if (samples[i].sensor < A1335_BUS_MAX_SENSORS) {
+        latestSample[samples[i].sensor].store(samples[i]);
+      }
+    }
+    cycleCount++;
+  }
+  task = nullptr;
+  vTaskDelete(nullptr);
+}
+
+#endif //A1335_RTOS
@@ -0,0 +1,85 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  FreeRTOS support: a transport with a per bus mutex and an
+  acquisition task per bus that publishes the latest sample of
+  every sensor for lock free readers. Needs A1335_RTOS.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335RTOS_H
+#define A1335RTOS_H
+
+#include "A1335.h"
+#include "A1335Bus.h"
+#include "A1335Stream.h"
+
+#if A1335_RTOS
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/semphr.h"
+  #include "freertos/task.h"
+#elif defined(__AVR__)
+  #include <Arduino_FreeRTOS.h>
+  #include <semphr.h>
+#else
+  #include <FreeRTOS.h>
+  #include <semphr.h>
+  #include <task.h>
+#endif
+
+class A1335LockedTransport : public A1335Transport { // another transport behind a recursive mutex, one per physical bus
+public:
+  A1335LockedTransport(A1335Transport& inner_);
+
+  byte probe(byte address) override;
+  byte write(byte address, byte reg, const byte* data, byte length) override;
+  byte select(byte address, byte reg) override;
+  byte receive(byte address, byte* data, byte length) override;
+  byte read(byte address, byte reg, byte* data, byte length) override;
+
+  void lock() override;
+  void unlock() override;
+
+private:
+  A1335Transport*   inner;
+  SemaphoreHandle_t mutex;
+};
+
+
+class A1335Worker {     // a task that runs bus.update() and keeps the latest sample of every sensor
+public:
+  A1335Worker(A1335Bus& bus_);
+
+  bool      begin(uint32_t periodMs = 1, UBaseType_t priority = 2, uint32_t stack = 2048, const char* name = "A1335");
+                                        // starts the task, one bus cycle every periodMs. periodMs = 0: one cycle per
+                                        // notify(), e.g. from a hardware timer. stack in the units of xTaskCreate()
+                                        // (bytes on ESP32, words elsewhere). Returns false if the task could not be created
+  void      stop();                     // ends the task after its current cycle, never while it holds the bus
+
+  void      notify();                   // starts one cycle when periodMs is 0
+  void      notifyFromISR();            // the same from an interrupt handler
+
+  bool      latest(byte index, A1335Sample& sample); // latest sample of the sensor with this bus index, never blocks.
+                                        // Returns false if there is none yet, or if the worker was interrupted in
+                                        // the middle of storing it by this task (try again later)
+  uint32_t  cycles();                   // bus cycles done so far
+
+  TaskHandle_t handle();
+
+private:
+  static void run(void* self);
+  void      loop();
+
+  A1335Bus*     bus;
+  TaskHandle_t  task = nullptr;
+  TickType_t    period = 0;
+  volatile bool stopping = false;
+  volatile uint32_t cycleCount = 0;
+  A1335Latest   latestSample[A1335_BUS_MAX_SENSORS];
+};
+
+#endif //A1335_RTOS
+
+#endif //A1335RTOS_H
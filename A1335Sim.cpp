@@ -0,0 +1,180 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Simulated sensor: the register map of A1335Mock with a
+  rotating magnet, noise, the output rate and injected faults.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Sim.h"
+
+using namespace A1335Reg;
+
+A1335Sim::A1335Sim(byte address_, uint32_t seed) : A1335Mock(address_), state(seed ? seed : 1){
+  setRegister(ERR,  0x0000);
+  setRegister(XERR, 0x0000);
+}
+
+void      A1335Sim::setSpeed(int32_t countsPerSecond){
+  refresh();
+  speed = countsPerSecond;
+}
+
+void      A1335Sim::setAngle(uint16_t raw){
+  refresh();
+  position = int64_t(raw & 0x0FFF) << 16;
+}
+
+void      A1335Sim::setNoise(uint16_t counts){
+  noise = counts;
+}
+
+void      A1335Sim::setHarmonicError(byte harmonic_, int8_t counts){
+  harmonic       = harmonic_;
+  harmonicCounts = counts;
+}
+
+void      A1335Sim::setTemperature(uint16_t raw){
+  setRegister(TSEN, TSEN_RIDC::set(TSEN_TEMP::set(0, raw), 0x0F));
+}
+
+void      A1335Sim::setField(uint16_t raw){
+  setRegister(FIELD, FIELD_RIDC::set(FIELD_FIELD::set(0, raw), 0x0E));
+}
+
+void      A1335Sim::setFaults(byte kinds, uint16_t rate){
+  faultKinds = kinds;
+  faultRate  = rate;
+}
+
+void      A1335Sim::useVirtualClock(bool enable){
+  virtualClock = enable;
+  clock = micros();
+  lastUpdate = clock;
+}
+
+void      A1335Sim::advance(uint32_t us){
+  clock += us;
+}
+
+uint32_t  A1335Sim::now(){
+  return virtualClock ? clock : micros();
+}
+
+uint32_t  A1335Sim::updates(){
+  return updateCount;
+}
+
+uint32_t  A1335Sim::faults(){
+  return faultCount;
+}
+
+uint32_t  A1335Sim::random(){           // xorshift32
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+bool      A1335Sim::inject(byte kind){
+  if (!(faultKinds & kind) || (random() & 0xFFFF) >= faultRate) {
+    return false;
+  }
+  faultCount++;
+  return true;
+}
+
+void      A1335Sim::refresh(){                 // produces the angles the sensor measured since the last transfer
+  uint32_t t = now();
+  uint32_t period = uint32_t(A1335_BASE_PERIOD_US) << ORATE_RATE::get(getExtended(ORATE));
+  uint32_t elapsed = t - lastUpdate;
+  if (elapsed < period) {
+    return;
+  }
+  uint32_t steps = elapsed / period;
+  lastUpdate += steps * period;
+  position += (int64_t(speed) * int64_t(steps * period) << 16) / 1000000;
+  if (STA_PHASE::get(getRegister(STA)) == 0) {
+    return;                             // idle, the processor does not measure
+  }
+  updateCount += steps;
+
+  int32_t angle = int32_t(position >> 16);
+  if (harmonicCounts) {
+    angle += (int32_t(harmonicCounts) * A1335Fixed::sinQ15(uint16_t(angle * harmonic) & 0x0FFF) + 16384) >> 15;
+  }
+  if (noise) {
+    angle += int32_t(random() % (2 * uint32_t(noise) + 1)) - noise;
+  }
+  uint16_t ang = ANG_NEW::set(ANG_ANGLE::set(0, uint16_t(angle)), 1);
+  if (inject(A1335_SIM_ERROR)) {
+    setRegister(ERR, getRegister(ERR) | 0x0001);
+  }
+  bool ef = ERR_FLAGS::get(getRegister(ERR)) != 0;  // the flag stays on until ERR is cleared
+  ang = ANG_EF::set(ang, ef);
+  setRegister(STA, STA_EF::set(getRegister(STA), ef));
+  uint16_t parity = ang;                // odd parity over the whole register
+  parity ^= parity >> 8;
+  parity ^= parity >> 4;
+  parity ^= parity >> 2;
+  parity ^= parity >> 1;
+  if (!(parity & 1)) {
+    ang = ANG_PAR::set(ang, 1);
+  }
+  setRegister(ANG, ang);
+  setRegister(STA, STA_NEW::set(getRegister(STA), 1));
+}
+
+byte      A1335Sim::probe(byte address_){
+  if (inject(A1335_SIM_NACK)) {
+    transfers++;
+    return 2;
+  }
+  return A1335Mock::probe(address_);
+}
+
+byte      A1335Sim::write(byte address_, byte reg, const byte* data, byte length){
+  refresh();
+  if (inject(A1335_SIM_NACK)) {
+    transfers++;
+    return 2;
+  }
+  return A1335Mock::write(address_, reg, data, length);
+}
+
+byte      A1335Sim::receive(byte address_, byte* data, byte length){
+  refresh();
+  if (address_ == address && inject(A1335_SIM_NACK)) {
+    transfers++;
+    return 2;
+  }
+  if (inject(A1335_SIM_TIMEOUT)) {
+    regs[EWCS + 1] = 0;                 // the extended access is still busy
+    regs[ERCS + 1] = 0;
+  }
+  byte start = pointer;
+  bool readsStatus = false;
+  for (byte i = 0; i < length; i++){
+    readsStatus |= ((start + i) & 0x3F) == STA || ((start + i) & 0x3F) == STA + 1;
+  }
+  byte error = A1335Mock::receive(address_, data, length);
+  if (error) {
+    return error;
+  }
+  if (readsStatus) {
+    setRegister(STA, STA_NEW::set(getRegister(STA), 0));  // reading STA clears its new flag
+  }
+  for (byte i = 0; i < length; i++){
+    if (((start + i) & 0x3F) == ANG && inject(A1335_SIM_PARITY)) {
+      data[i] ^= 0x01;                  // one bit of the angle flips on the wire
+    }
+  }
+  if (length > 1 && inject(A1335_SIM_SHORT)) {
+    byte cut = 1 + random() % (length - 1);
+    for (byte i = cut; i < length; i++){
+      data[i] = 0;
+    }
+    return A1335_SHORT_READ;
+  }
+  return 0;
+}
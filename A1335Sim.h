@@ -0,0 +1,65 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Simulated sensor: the register map of A1335Mock with a
+  rotating magnet, noise, the output rate and injected faults.
+  Runs on its own clock, so a test can run faster than real time.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335SIM_H
+#define A1335SIM_H
+
+#include "A1335.h"
+
+// Faults the simulation can inject, see setFaults()
+const byte A1335_SIM_NACK    = B00000001;   // the sensor does not acknowledge a transfer
+const byte A1335_SIM_SHORT   = B00000010;   // a read returns too few bytes
+const byte A1335_SIM_PARITY  = B00000100;   // a bit of the angle register flips on the wire
+const byte A1335_SIM_ERROR   = B00001000;   // the sensor reports an error (EF flag and ERR)
+const byte A1335_SIM_TIMEOUT = B00010000;   // an extended access does not finish in time
+
+class A1335Sim : public A1335Mock {
+public:
+  A1335Sim(byte address_ = 0x0C, uint32_t seed = 1);
+
+  void      setSpeed(int32_t countsPerSecond);  // speed of the magnet, 4096 = 1 turn per second
+  void      setAngle(uint16_t raw);             // puts the magnet to an angle
+  void      setNoise(uint16_t counts);          // adds uniform noise of +- counts to every new angle
+  void      setHarmonicError(byte harmonic, int8_t counts); // adds counts * sin(harmonic * angle), like an off-axis magnet
+  void      setTemperature(uint16_t raw);       // raw temperature, 8 = 1 K
+  void      setField(uint16_t raw);             // raw field strength, 1 = 1 G
+  void      setFaults(byte kinds, uint16_t rate); // injects the A1335_SIM_* kinds, each transfer with probability rate / 65536
+
+  void      useVirtualClock(bool enable);       // true: time only moves with advance(), false: micros()
+  void      advance(uint32_t us);               // moves the virtual clock
+  uint32_t  now();                              // current simulation time in us
+
+  uint32_t  updates();                          // new angles produced so far
+  uint32_t  faults();                           // faults injected so far
+
+  byte probe(byte address) override;
+  byte write(byte address, byte reg, const byte* data, byte length) override;
+  byte receive(byte address, byte* data, byte length) override;
+
+private:
+  void      refresh();                  // brings the registers up to the current time
+  bool      inject(byte kind);          // true if a fault of this kind happens now
+  uint32_t  random();
+
+  uint32_t  state;                      // random generator
+  int32_t   speed = 0;
+  uint16_t  noise = 0;
+  byte      harmonic = 0;
+  int8_t    harmonicCounts = 0;
+  byte      faultKinds = 0;
+  uint16_t  faultRate = 0;
+  bool      virtualClock = false;
+  uint32_t  clock = 0;                  // virtual time in us
+  uint32_t  lastUpdate = 0;             // time of the last new angle
+  int64_t   position = 0;               // magnet angle in 1/65536 counts, wraps
+  uint32_t  updateCount = 0;
+  uint32_t  faultCount = 0;
+};
+
+#endif //A1335SIM_H
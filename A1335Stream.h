@@ -0,0 +1,141 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Lock-free single producer / single consumer ring buffer of
+  timestamped angle samples.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335STREAM_H
+#define A1335STREAM_H
+
+#include "A1335.h"
+
+// Keeps the compiler (and on multi core chips the CPU) from reordering the sample
+// copy and the index update. A single byte index is written atomically everywhere.
+#if defined(__AVR__)
+  #define A1335_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+  #define A1335_BARRIER() __sync_synchronize()
+#endif
+
+// Size has to be a power of two up to 128. The producer (timer ISR, data ready ISR or
+// acquisition task) calls push() or sample(), the consumer pop() or popBatch().
+// Neither side ever waits: a full buffer drops the new sample and counts it.
+
+template <byte Size>
+class A1335Ring {
+  static_assert(Size >= 2 && Size <= 128 && (Size & (Size - 1)) == 0, "Size has to be a power of two up to 128");
+
+public:
+  bool      push(const A1335Sample& sample){    // producer side. Returns false if the buffer was full
+    byte h = head;
+    if (byte(h - tail) >= Size) {
+      overflowCount++;
+      return false;
+    }
+    A1335_BARRIER();                     // the slot is free only once the consumer's copy out of it is visible
+    data[h & (Size - 1)] = sample;
+    A1335_STAMP(data[h & (Size - 1)], pushed);
+    A1335_BARRIER();                     // the sample has to be complete before the consumer sees it
+    head = h + 1;
+    return true;
+  }
+
+  bool      sample(A1335& sensor, byte index = 0){  // producer side: reads one angle from the sensor and pushes it
+    A1335Sample s;
+    sensor.readSample(s, index);          // a failed read is pushed too, flagged A1335_STATUS_BUS
+    return push(s);
+  }
+
+  bool      pop(A1335Sample& sample){           // consumer side. Returns false if the buffer was empty
+    byte t = tail;
+    if (t == head) {
+      return false;
+    }
+    A1335_BARRIER();                     // head before data: the sample may not be read before it is complete
+    sample = data[t & (Size - 1)];
+    A1335_STAMP(sample, popped);
+    A1335_BARRIER();                     // the copy has to be done before the producer may overwrite it
+    tail = t + 1;
+    return true;
+  }
+
+  byte      popBatch(A1335Sample* out, byte max){  // consumer side: takes up to max samples at once
+    byte t = tail;
+    byte n = byte(head - t);
+    if (n > max) {
+      n = max;
+    }
+    A1335_BARRIER();                     // head before data, as in pop()
+    for (byte i = 0; i < n; i++){
+      out[i] = data[(t + i) & (Size - 1)];
+      A1335_STAMP(out[i], popped);
+    }
+    A1335_BARRIER();
+    tail = t + n;
+    return n;
+  }
+
+  byte      available(){                        // number of samples waiting
+    return byte(head - tail);
+  }
+
+  uint32_t  overflows(){                        // samples dropped because the buffer was full
+    return overflowCount;
+  }
+
+private:
+  A1335Sample       data[Size];
+  volatile byte     head = 0;           // written by the producer only, counts up and wraps at 256
+  volatile byte     tail = 0;           // written by the consumer only
+  volatile uint32_t overflowCount = 0;  // written by the producer only
+};
+
+// Latest sample of one sensor for any number of readers. The single writer never waits,
+// a reader retries while a write is in progress (seqlock), but only A1335_LATEST_RETRIES
+// times: a reader that preempted the writer on the same core would otherwise spin forever.
+// The sequence counter is a byte, so it is written atomically everywhere; a reader would
+// need 128 writes during one copy to be fooled.
+
+#ifndef A1335_LATEST_RETRIES
+#define A1335_LATEST_RETRIES 16
+#endif
+
+class A1335Latest {
+public:
+  void      store(const A1335Sample& sample){   // writer side
+    byte s = sequence;
+    sequence = s + 1;                    // odd: write in progress
+    A1335_BARRIER();
+    data = sample;
+    A1335_STAMP(data, pushed);
+    A1335_BARRIER();
+    byte next = s + 2;
+    sequence = next ? next : 2;          // 0 is kept for "never written"
+  }
+
+  bool      load(A1335Sample& sample) const {    // reader side, lock free. Returns false if nothing was stored yet
+                                        // or the writer stayed in the middle of a store, then sample is not valid
+    for (byte retry = 0; retry < A1335_LATEST_RETRIES; retry++){
+      byte s = sequence;
+      if (s & 1) {
+        continue;                        // the writer is in the middle of an update
+      }
+      A1335_BARRIER();
+      sample = data;
+      A1335_BARRIER();
+      if (sequence == s) {
+        A1335_STAMP(sample, popped);
+        return s != 0;
+      }
+    }
+    return false;                        // the writer was preempted by this reader, try again later
+  }
+
+private:
+  A1335Sample data = {};
+  volatile byte sequence = 0;
+};
+
+#endif //A1335STREAM_H
@@ -0,0 +1,96 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Multi-turn tracking: unwraps the raw angle into a 64 bit
+  position and estimates the speed with an alpha-beta filter.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Tracker.h"
+
+const int32_t COUNTS  = 4096;           // counts per turn
+const int32_t US      = 1000000;        // us per second
+
+A1335Tracker::A1335Tracker(uint16_t alpha_, uint16_t beta_) : alpha(alpha_), beta(beta_){
+
+}
+
+void      A1335Tracker::reset(){
+  started = false;
+  pos = est = 0;
+  vel = 0;
+  count = 0;
+}
+
+bool      A1335Tracker::update(uint16_t raw, uint32_t time){  // unwraps the angle and runs one filter step
+  raw &= COUNTS - 1;
+  if (!started) {
+    started  = true;
+    lastRaw  = raw;
+    lastTime = time;
+    pos      = raw;
+    est      = int64_t(raw) << 8;
+    count    = 1;
+    return true;
+  }
+  int32_t dt = int32_t(time - lastTime);
+  if (dt <= 0) {
+    return false;                       // same or older timestamp, a duplicate
+  }
+
+  int32_t step = int16_t((raw - lastRaw) << 4) >> 4;  // shortest way, -2048..2047
+  int64_t moved = (int64_t(vel) * dt) / (int64_t(US) << 8);  // what the speed estimate expects
+  if (moved > COUNTS / 2 || moved < -COUNTS / 2) {
+    int32_t extra = (moved - step + (moved > step ? COUNTS / 2 : -COUNTS / 2)) / COUNTS;
+    step += extra * COUNTS;             // samples were dropped at high speed, add the missed turns
+  }
+  pos += step;
+
+  int64_t predicted = est + (int64_t(vel) * dt) / US;
+  int64_t residual  = (pos << 8) - predicted;
+  est = predicted + ((residual * alpha) >> 8);
+  vel += int32_t(((residual * beta) >> 8) * US / dt);
+
+  lastRaw  = raw;
+  lastTime = time;
+  count++;
+  return true;
+}
+
+bool      A1335Tracker::update(const A1335Sample& sample){
+  if ((sample.flags & (A1335_STATUS_NEW | A1335_STATUS_INVALID)) != A1335_STATUS_NEW) {
+    return false;
+  }
+  return update(sample.angle, sample.time);
+}
+
+bool      A1335Tracker::update(const A1335Snapshot& snap, uint32_t time){
+  if ((snap.status & (A1335_STATUS_NEW | A1335_STATUS_INVALID)) != A1335_STATUS_NEW) {
+    return false;
+  }
+  return update(snap.angle, time);
+}
+
+int64_t   A1335Tracker::position(){
+  return pos;
+}
+
+int32_t   A1335Tracker::turns(){
+  return int32_t(pos >> 12);
+}
+
+int64_t   A1335Tracker::estimate(){
+  return est;
+}
+
+int64_t   A1335Tracker::predict(uint32_t time){
+  return est + (int64_t(vel) * int32_t(time - lastTime)) / US;
+}
+
+int32_t   A1335Tracker::velocity(){
+  return vel >> 8;
+}
+
+uint32_t  A1335Tracker::samples(){
+  return count;
+}
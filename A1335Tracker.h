@@ -0,0 +1,45 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Multi-turn tracking: unwraps the raw angle into a 64 bit
+  position and estimates the speed with an alpha-beta filter.
+  Integer math only, constant work per sample.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335TRACKER_H
+#define A1335TRACKER_H
+
+#include "A1335.h"
+
+class A1335Tracker {
+public:
+  A1335Tracker(uint16_t alpha_ = 64, uint16_t beta_ = 8);
+                                        // filter gains in 1/256: position correction alpha, speed correction beta
+
+  void      reset();                    // forgets everything, the next sample starts at turn 0
+
+  bool      update(uint16_t raw, uint32_t time);  // adds a raw angle taken at time (micros()). Returns false if it was rejected
+  bool      update(const A1335Sample& sample);    // skips invalid and repeated samples
+  bool      update(const A1335Snapshot& snap, uint32_t time);
+
+  int64_t   position();                 // unwrapped measured position, 4096 per turn
+  int32_t   turns();                    // full turns, rounded towards minus infinity
+  int64_t   estimate();                 // filtered position in 1/256 counts
+  int64_t   predict(uint32_t time);     // filtered position extrapolated to time, in 1/256 counts
+  int32_t   velocity();                 // filtered speed in counts per second (4096 = 1 turn/s)
+  uint32_t  samples();                  // samples accepted so far
+
+private:
+  uint16_t  alpha;
+  uint16_t  beta;
+  bool      started = false;
+  uint16_t  lastRaw = 0;
+  uint32_t  lastTime = 0;
+  int64_t   pos = 0;                    // measured, counts
+  int64_t   est = 0;                    // filtered, 1/256 counts
+  int32_t   vel = 0;                    // filtered, 1/256 counts per second
+  uint32_t  count = 0;
+};
+
+#endif //A1335TRACKER_H
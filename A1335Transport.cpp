@@ -0,0 +1,269 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Transports: the register access used by the A1335 class.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335Transport.h"
+
+byte      A1335Transport::read(byte address, byte reg, byte* data, byte length){
+  byte error = select(address, reg);
+  if (error) {
+    return error;
+  }
+  return receive(address, data, length);
+}
+
+
+//--- I2C ---//
+
+A1335I2C A1335Wire(Wire);
+
+byte      A1335I2C::probe(byte address){
+  wire->beginTransmission(address);
+  return wire->endTransmission();
+}
+
+byte      A1335I2C::write(byte address, byte reg, const byte* data, byte length){
+  wire->beginTransmission(address);
+  wire->write(reg);                       // choose target register
+  for (byte i = 0; i < length; i++){
+    wire->write(data[i]);
+  }
+  return wire->endTransmission();
+}
+
+byte      A1335I2C::select(byte address, byte reg){
+  wire->beginTransmission(address);
+  wire->write(reg);                       // choose target register
+  return wire->endTransmission();
+}
+
+byte      A1335I2C::receive(byte address, byte* data, byte length){
+  byte received = wire->requestFrom(address, length);
+  for (byte i = 0; i < length; i++){
+    data[i] = (i < received && wire->available()) ? wire->read() : 0;
+  }
+  return received < length ? A1335_SHORT_READ : 0;
+}
+
+
+//--- SPI ---//
+
+// 16 bit frames: bit 15 = write; bits 13:8 = register address; bits 7:0 = data to write.
+// The answer to a read command is clocked out during the following frame, so a block of
+// n registers takes n + 1 frames: every frame carries the next command and the previous result.
+// With CRC enabled a third byte follows each frame, its upper nibble holds the CRC.
+const uint16_t SPI_WRITE = 0x8000;
+const byte     SPI_ADDR  = 0x3F;
+
+A1335SPI::A1335SPI(SPIClass& spi_, byte csPin_, uint32_t clock) :
+  spi(&spi_), settings(clock, MSBFIRST, SPI_MODE3), csPin(csPin_){
+
+}
+
+void      A1335SPI::begin(){
+  pinMode(csPin, OUTPUT);
+  digitalWrite(csPin, HIGH);
+}
+
+void      A1335SPI::setCrc(bool enable){
+  crc = enable;
+}
+
+uint32_t  A1335SPI::crcErrors(){
+  return crcErrorCount;
+}
+
+byte      A1335SPI::crc4(uint16_t frame){
+  byte value = 0x0F;
+  for (int8_t bit = 15; bit >= 0; bit--){
+    byte in = ((frame >> bit) & 1) ^ (value >> 3);
+    value = (value << 1) & 0x0F;
+    if (in) {
+      value ^= 0x03;
+    }
+  }
+  return value;
+}
+
+uint16_t  A1335SPI::frame(uint16_t command){
+  digitalWrite(csPin, LOW);
+  uint16_t answer = spi->transfer16(command);
+  if (crc) {
+    byte check = spi->transfer(crc4(command) << 4);
+    if ((check >> 4) != crc4(answer)) {
+      crcOk = false;
+      crcErrorCount++;
+    }
+  }
+  digitalWrite(csPin, HIGH);
+  return answer;
+}
+
+byte      A1335SPI::probe(byte address){        // reads STA and checks its identifier code 1000
+  byte sta[2];
+  if (read(address, 0x22, sta, 2)) {
+    return 4;
+  }
+  return (sta[0] & 0xF0) == 0x80 ? 0 : 2;
+}
+
+byte      A1335SPI::write(byte, byte reg, const byte* data, byte length){
+  spi->beginTransaction(settings);
+  crcOk = true;
+  for (byte i = 0; i < length; i++){
+    frame(SPI_WRITE | (uint16_t((reg + i) & SPI_ADDR) << 8) | data[i]);  // one byte per frame
+  }
+  spi->endTransaction();
+  pointer = reg + length;                 // behaves like the I2C pointer after a write
+  return crcOk ? 0 : 4;
+}
+
+byte      A1335SPI::select(byte, byte reg){
+  pointer = reg;
+  return 0;
+}
+
+byte      A1335SPI::receive(byte, byte* data, byte length){
+  byte first = pointer & ~1;              // the sensor answers with whole 16 bit registers
+  byte words = ((pointer & 1) + length + 1) / 2;
+  byte skip  = pointer & 1;               // an odd pointer starts with the low byte
+  byte i = 0;
+  spi->beginTransaction(settings);
+  crcOk = true;
+  frame(uint16_t(first & SPI_ADDR) << 8); // the first answer belongs to an older command
+  for (byte w = 0; w < words; w++){
+    byte next = first + 2 * (w + 1);
+    if (w + 1 == words) {
+      next = first + 2 * w;               // last frame only clocks out the result, repeat the command
+    }
+    uint16_t word = frame(uint16_t(next & SPI_ADDR) << 8);
+    if (!skip && i < length) {
+      data[i++] = byte(word >> 8);
+    }
+    skip = 0;
+    if (i < length) {
+      data[i++] = byte(word);
+    }
+  }
+  spi->endTransaction();
+  pointer += length;
+  return crcOk ? 0 : 4;
+}
+
+
+//--- Mock ---//
+
+A1335Mock::A1335Mock(byte address_) : address(address_){
+  memset(regs, 0, sizeof(regs));
+  setRegister(0x22, 0x8011);              // STA: running, processing angles
+  setRegister(0x28, 0xF000 | (298 * 8));  // TSEN: 298 K
+  setRegister(0x2A, 0xE000 | 500);        // FIELD: 500 G
+  setRegister(0x20, 0x1000);              // ANG: 0 with correct parity
+}
+
+byte      A1335Mock::probe(byte address_){
+  transfers++;
+  return address_ == address ? 0 : 2;
+}
+
+byte      A1335Mock::write(byte address_, byte reg, const byte* data, byte length){
+  transfers++;
+  if (address_ != address) {
+    return 2;
+  }
+  pointer = reg;
+  for (byte i = 0; i < length; i++){
+    store(pointer++, data[i]);
+  }
+  return 0;
+}
+
+byte      A1335Mock::select(byte address_, byte reg){
+  transfers++;
+  if (address_ != address) {
+    return 2;
+  }
+  pointer = reg;
+  return 0;
+}
+
+byte      A1335Mock::receive(byte address_, byte* data, byte length){
+  transfers++;
+  if (address_ != address) {
+    return 2;
+  }
+  for (byte i = 0; i < length; i++){
+    data[i] = regs[pointer & 0x3F];
+    if ((pointer & 0x3F) == 0x20 && (regs[0x20] & 0x20)) {
+      regs[0x20] ^= B00110000;            // reading the angle clears its new flag, the parity bit follows
+    }
+    pointer++;
+  }
+  return 0;
+}
+
+void      A1335Mock::store(byte reg, byte value){  // a byte written by the master, handles the control registers
+  reg &= 0x3F;
+  regs[reg] = value;
+  if (reg == 0x08 && (value & 0x80)) {    // EWCS: extended write
+    extData[slot(getRegister(0x02))] = (uint32_t(getRegister(0x04)) << 16) | getRegister(0x06);
+    regs[0x09] = 0x01;                    // done
+  } else if (reg == 0x0C && (value & 0x80)) { // ERCS: extended read
+    uint32_t value32 = extData[slot(getRegister(0x0A))];
+    setRegister(0x0E, value32 >> 16);
+    setRegister(0x10, value32);
+    regs[0x0D] = 0x01;                    // done
+  } else if (reg == 0x1F && value == 0x46) {  // CTRL key
+    byte ctrl = regs[0x1E];
+    if ((ctrl & 0xC0) == 0xC0) {
+      regs[0x23] = 0x11;                  // run
+    } else if (ctrl & 0x80) {
+      regs[0x23] = 0x10;                  // idle
+    }
+    if (ctrl & 0x01) {
+      regs[0x24] &= 0xF0;                 // clear ERR, keeps the identifier code
+      regs[0x25]  = 0;
+    }
+    if (ctrl & 0x02) {
+      regs[0x26] &= 0xF0;                 // clear XERR
+      regs[0x27]  = 0;
+    }
+    if (ctrl & 0x04) {
+      regs[0x22] &= 0xF0;                 // clear STA flags
+    }
+  }
+}
+
+byte      A1335Mock::slot(uint16_t reg){
+  for (byte i = 0; i < extCount; i++){
+    if (extAddr[i] == reg) {
+      return i;
+    }
+  }
+  if (extCount < EXT_SLOTS) {
+    extAddr[extCount] = reg;
+    extData[extCount] = 0;
+    return extCount++;
+  }
+  return EXT_SLOTS - 1;                   // full, reuse the last slot
+}
+
+void      A1335Mock::setRegister(byte reg, uint16_t value){
+  regs[reg & 0x3F]       = byte(value >> 8);
+  regs[(reg + 1) & 0x3F] = byte(value);
+}
+
+uint16_t  A1335Mock::getRegister(byte reg){
+  return (uint16_t(regs[reg & 0x3F]) << 8) | regs[(reg + 1) & 0x3F];
+}
+
+void      A1335Mock::setExtended(uint16_t reg, uint32_t value){
+  extData[slot(reg)] = value;
+}
+
+uint32_t  A1335Mock::getExtended(uint16_t reg){
+  return extData[slot(reg)];
+}
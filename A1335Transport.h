@@ -0,0 +1,125 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Transports: the register access used by the A1335 class.
+  A1335I2C talks to any TwoWire, A1335SPI to the SPI interface
+  of the sensor and A1335Mock keeps the registers in memory.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335TRANSPORT_H
+#define A1335TRANSPORT_H
+
+#if (ARDUINO >= 100)
+     #include "Arduino.h"
+#else
+     #include "WProgram.h"
+#endif
+#include <Wire.h>
+#include <SPI.h>
+
+// All transport functions return 0 on success, otherwise the codes of Wire.endTransmission():
+// 1 = data too long; 2 = NACK on address; 3 = NACK on data; 4 = other error; 5 = timeout
+// and A1335_SHORT_READ if fewer bytes arrived than requested
+
+const byte A1335_SHORT_READ = 6;
+
+class A1335Transport {
+public:
+  virtual byte probe(byte address) = 0;                 // 0 if a device answers at address
+  virtual byte write(byte address, byte reg, const byte* data, byte length) = 0;
+                                                        // writes length bytes starting at register reg
+  virtual byte select(byte address, byte reg) = 0;      // sets the register pointer for the next receive()
+  virtual byte receive(byte address, byte* data, byte length) = 0;
+                                                        // reads length bytes from the register pointer on, it auto-increments
+
+  virtual byte read(byte address, byte reg, byte* data, byte length); // select() followed by receive()
+
+  virtual void lock() {}                                // takes the bus for a sequence of calls, may nest.
+  virtual void unlock() {}                              // Only used with A1335_RTOS, see A1335Rtos.h
+};
+
+class A1335BusLock {     // holds the lock of a transport while in scope
+public:
+  A1335BusLock(A1335Transport& transport_) : transport(transport_) { transport.lock(); }
+  ~A1335BusLock() { transport.unlock(); }
+
+private:
+  A1335Transport& transport;
+};
+
+
+class A1335I2C : public A1335Transport { // I2C on any TwoWire instance (Wire, Wire1, ...)
+public:
+  constexpr A1335I2C(TwoWire& wire_) : wire(&wire_) {}
+
+  byte probe(byte address) override;
+  byte write(byte address, byte reg, const byte* data, byte length) override;
+  byte select(byte address, byte reg) override;
+  byte receive(byte address, byte* data, byte length) override;
+
+private:
+  TwoWire*  wire;
+};
+
+extern A1335I2C A1335Wire;                 // transport on the global Wire, used by default
+
+
+class A1335SPI : public A1335Transport { // SPI, one sensor per chip select, the address is ignored
+public:
+  A1335SPI(SPIClass& spi_, byte csPin_, uint32_t clock = 4000000);
+
+  void begin();                         // configures the chip select pin. SPI.begin() has to be called by the sketch
+  void setCrc(bool enable);             // every frame carries a 4 bit CRC, has to match the CRC setting in the sensor EEPROM
+  uint32_t crcErrors();                 // number of answers with a wrong CRC so far
+
+  byte probe(byte address) override;
+  byte write(byte address, byte reg, const byte* data, byte length) override;
+  byte select(byte address, byte reg) override;
+  byte receive(byte address, byte* data, byte length) override;
+
+  static byte crc4(uint16_t frame);     // CRC x^4 + x + 1, seed 1111, over the 16 bit frame
+
+private:
+  uint16_t  frame(uint16_t command);    // one transfer inside an open transaction, returns the answer to the previous command
+
+  SPIClass* spi;
+  SPISettings settings;
+  byte      csPin;
+  byte      pointer = 0;                // emulated register pointer, SPI addresses every word directly
+  bool      crc = false;
+  bool      crcOk = true;               // all answers of the current transaction had a correct CRC
+  uint32_t  crcErrorCount = 0;
+};
+
+
+class A1335Mock : public A1335Transport { // register file in memory, for sketches and tests without hardware
+public:
+  A1335Mock(byte address_ = 0x0C);
+
+  byte probe(byte address) override;
+  byte write(byte address, byte reg, const byte* data, byte length) override;
+  byte select(byte address, byte reg) override;
+  byte receive(byte address, byte* data, byte length) override;
+
+  void      setRegister(byte reg, uint16_t value);          // sets a normal register (MSB at reg)
+  uint16_t  getRegister(byte reg);
+  void      setExtended(uint16_t reg, uint32_t value);      // sets an extended register
+  uint32_t  getExtended(uint16_t reg);
+
+  uint32_t  transfers = 0;              // number of bus transactions so far
+
+protected:
+  static const byte EXT_SLOTS = 8;      // number of extended registers the mock can hold
+  void      store(byte reg, byte value);
+  byte      slot(uint16_t reg);         // slot of an extended register, allocates one if needed
+
+  byte      address;
+  byte      pointer = 0;
+  byte      regs[0x40];                 // normal register space
+  uint16_t  extAddr[EXT_SLOTS];
+  uint32_t  extData[EXT_SLOTS];
+  byte      extCount = 0;
+};
+
+#endif //A1335TRANSPORT_H
@@ -0,0 +1,143 @@
+/***************************************************
+  Benchmark for the A1335 library.
+  Times the read functions at several I2C clocks and prints
+  min / mean / p99 latency and samples per second, per sensor
+  and for the whole bus.
+
+  Set USE_MOCK to 1 to run against the in-memory A1335Mock,
+  without any sensor connected. That measures the library
+  overhead alone and is useful to catch regressions; the host
+  build in extras/host runs it that way on a PC.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include <A1335.h>
+#include <A1335Bus.h>
+
+#ifndef USE_MOCK
+#define USE_MOCK 0
+#endif
+
+#ifndef PAUSE_MS
+#define PAUSE_MS 5000                   // between two rounds of measurements
+#endif
+
+const byte     RUNS      = 200;         // calls per measurement
+const uint32_t CLOCKS[]  = { 100000, 400000, 1000000 };
+const byte     MAX_SENSORS = 4;
+
+#if USE_MOCK
+A1335Mock      mock(0x0C);
+A1335Transport& transport = mock;
+#else
+A1335Transport& transport = A1335Wire;
+#endif
+
+A1335          sensors[MAX_SENSORS];
+A1335Bus       bus;
+byte           sensorCount = 0;
+uint16_t       times[RUNS];             // duration of each call in timer ticks >> TICK_SHIFT
+
+#if defined(DWT) && defined(CoreDebug)  // Cortex-M3 and up: cycle counter
+#define USE_DWT 1
+const byte     TICK_SHIFT = 4;          // cycles / 16, so 16 bit hold a million cycles
+void     timerBegin(){
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL  |= DWT_CTRL_CYCCNTENA_Msk;
+}
+uint32_t now(){ return DWT->CYCCNT; }
+uint32_t toNanos(uint32_t ticks){ return uint32_t((uint64_t(ticks) << TICK_SHIFT) * 1000000000ULL / F_CPU); }
+#elif defined(A1335_HOST)               // host build: the steady clock of the PC in ns
+#define USE_DWT 0
+const byte     TICK_SHIFT = 0;
+void     timerBegin(){}
+uint32_t now(){ return hostNanos(); }
+uint32_t toNanos(uint32_t ticks){ return ticks; }
+#else
+#define USE_DWT 0
+const byte     TICK_SHIFT = 0;
+void     timerBegin(){}
+uint32_t now(){ return micros(); }
+uint32_t toNanos(uint32_t ticks){ return ticks * 1000; }
+#endif
+
+void sortTimes(){                       // insertion sort, only done once per measurement
+  for (byte i = 1; i < RUNS; i++){
+    uint16_t t = times[i];
+    byte j = i;
+    while (j > 0 && times[j - 1] > t) {
+      times[j] = times[j - 1];
+      j--;
+    }
+    times[j] = t;
+  }
+}
+
+void report(const char* name, byte readsPerCall){  // prints the statistics of times[]
+  uint32_t sum = 0;
+  for (byte i = 0; i < RUNS; i++){
+    sum += times[i];
+  }
+  sortTimes();
+  uint32_t meanNs = toNanos(sum) / RUNS;
+  Serial.print(name);
+  Serial.print("\tmin ");
+  Serial.print(toNanos(times[0]) / 1000.0, 2);
+  Serial.print(" us\tmean ");
+  Serial.print(meanNs / 1000.0, 2);
+  Serial.print(" us\tp99 ");
+  Serial.print(toNanos(times[(RUNS * 99) / 100]) / 1000.0, 2);
+  Serial.print(" us\t");
+  Serial.print(meanNs ? uint32_t(1000000000ULL * readsPerCall / meanNs) : 0);
+  Serial.println(" samples/s");
+}
+
+#define MEASURE(name, readsPerCall, call)           \
+  for (byte i = 0; i < RUNS; i++){                  \
+    uint32_t begin = now();                         \
+    call;                                           \
+    uint32_t ticks = (now() - begin) >> TICK_SHIFT; \
+    times[i] = ticks > 0xFFFF ? 0xFFFF : ticks;     \
+  }                                                 \
+  report(name, readsPerCall);
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {}
+  Wire.begin();
+  timerBegin();
+  sensorCount = bus.scan(transport, sensors, MAX_SENSORS);
+  Serial.print("Sensors found: ");
+  Serial.println(sensorCount);
+#if USE_DWT
+  Serial.println("Times from the DWT cycle counter");
+#endif
+}
+
+void loop() {
+  if (!sensorCount) {
+    delay(1000);
+    return;
+  }
+  A1335& sensor = sensors[0];
+  A1335Snapshot snap;
+  A1335Sample sample;
+  uint32_t orate;
+
+  for (byte c = 0; c < sizeof(CLOCKS) / sizeof(CLOCKS[0]); c++){
+    Wire.setClock(CLOCKS[c]);
+    Serial.print("--- I2C clock ");
+    Serial.print(CLOCKS[c] / 1000);
+    Serial.println(" kHz ---");
+
+    MEASURE("readAngleRaw", 1, sensor.readAngleRaw());
+    MEASURE("readSample  ", 1, sensor.readSample(sample));
+    MEASURE("readAll     ", 1, sensor.readAll(snap));
+    MEASURE("extendedRead", 1, sensor.extendedRead(A1335Reg::ORATE, orate));
+    MEASURE("bus.update  ", sensorCount, bus.update());
+  }
+  Serial.println();
+  delay(PAUSE_MS);
+}
@@ -0,0 +1,196 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  PC side decoder for logs written by A1335LogWriter, see
+  A1335Log.h for the format. The file is memory mapped and
+  indexed by block, so seeking in long captures is instant.
+
+  Build:  g++ -O2 -std=c++11 -o A1335LogDecode A1335LogDecode.cpp
+  Usage:  A1335LogDecode capture.bin [from_us [to_us]]
+          prints time_us,sensor,angle,flags per sample and
+          time_us,sensor,temp,field lines starting with # for
+          the side records. Times are unwrapped to 64 bit.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint8_t  LOG_VERSION     = 1;
+const size_t   HEADER_SIZE     = 14;
+const uint8_t  PAD             = 0x00;
+const uint8_t  CYCLE8          = 0x01;
+const uint8_t  CYCLE16         = 0x02;
+const uint8_t  CYCLE32         = 0x04;
+const uint8_t  SIDE            = 0x10;
+const uint8_t  STALE           = 0x40;
+const int      MAX_SENSORS     = 8;
+
+// flag bits of the output, same as A1335_STATUS_* in A1335.h
+const unsigned FLAG_NEW        = 1;
+const unsigned FLAG_ERROR      = 2;
+const unsigned FLAG_INVALID    = 4;
+
+uint16_t load_le16(const uint8_t* p) { return uint16_t(p[0] | (p[1] << 8)); }
+uint32_t load_le32(const uint8_t* p) { return load_le16(p) | (uint32_t(load_le16(p + 2)) << 16); }
+
+struct Block {
+  size_t   offset;
+  uint64_t time;                        // unwrapped time of the header
+};
+
+class Log {
+public:
+  bool open(const char* path){
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < off_t(HEADER_SIZE)) {
+      close(fd);
+      return false;
+    }
+    size = size_t(st.st_size);
+    data = static_cast<const uint8_t*>(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+    close(fd);
+    if (data == MAP_FAILED) {
+      data = nullptr;
+      return false;
+    }
+    return index();
+  }
+
+  ~Log(){
+    if (data) {
+      munmap(const_cast<uint8_t*>(data), size);
+    }
+  }
+
+  void dump(uint64_t from, uint64_t to) const {   // decodes the blocks that can hold samples in [from, to]
+    auto first = std::upper_bound(blocks.begin(), blocks.end(), from,
+                                  [](uint64_t t, const Block& b) { return t < b.time; });
+    if (first != blocks.begin()) {
+      --first;                          // the block that starts before from still holds samples after it
+    }
+    for (auto b = first; b != blocks.end() && b->time <= to; ++b){
+      decodeBlock(*b, from, to);
+    }
+  }
+
+  size_t blockCount() const { return blocks.size(); }
+
+private:
+  bool index(){                         // one header read per block, the records are not touched
+    blockSize = load_le16(data + 4);
+    if (data[0] != 0xA1 || data[1] != 0x35 || data[2] != LOG_VERSION || blockSize < HEADER_SIZE) {
+      return false;
+    }
+    uint64_t time = 0;
+    uint32_t previous = 0;
+    for (size_t offset = 0; offset + HEADER_SIZE <= size; offset += blockSize){
+      const uint8_t* h = data + offset;
+      if (h[0] != 0xA1 || h[1] != 0x35) {
+        break;                          // a cut off last block
+      }
+      uint32_t t = load_le32(h + 10);
+      time = blocks.empty() ? t : time + uint32_t(t - previous);
+      previous = t;
+      blocks.push_back({ offset, time });
+    }
+    return !blocks.empty();
+  }
+
+  void decodeBlock(const Block& block, uint64_t from, uint64_t to) const {
+    const uint8_t* p   = data + block.offset;
+    const uint8_t* end = p + std::min(blockSize, size - block.offset);
+    int sensors = std::min<int>(p[3], MAX_SENSORS);
+    uint16_t last[MAX_SENSORS] = {};
+    uint64_t time = block.time;
+    p += HEADER_SIZE;
+    while (p < end) {
+      uint8_t tag = *p++;
+      if (tag == PAD) {
+        break;
+      }
+      if (tag == SIDE) {
+        if (end - p < 5) {
+          return;
+        }
+        if (time >= from && time <= to) {
+          printf("#%llu,%u,%u,%u\n", (unsigned long long)time, p[0], load_le16(p + 1), load_le16(p + 3));
+        }
+        p += 5;
+        continue;
+      }
+      size_t dtBytes = tag == CYCLE8 ? 1 : tag == CYCLE16 ? 2 : tag == CYCLE32 ? 4 : 0;
+      if (dtBytes == 0 || size_t(end - p) < dtBytes + 1) {
+        fprintf(stderr, "bad record 0x%02X at offset %zu\n", tag, size_t(p - 1 - data));
+        return;
+      }
+      time += dtBytes == 1 ? p[0] : dtBytes == 2 ? load_le16(p) : load_le32(p);
+      p += dtBytes;
+      uint8_t mask = *p++;
+      for (int s = 0; s < sensors; s++){
+        if (!(mask & (1 << s))) {
+          continue;
+        }
+        if (p >= end) {
+          return;
+        }
+        uint8_t code = *p++;
+        unsigned flags;
+        if (code & 0x80) {
+          if (p >= end) {
+            return;
+          }
+          last[s] = uint16_t(((code & 0x0F) << 8) | *p++);
+          flags = (code & 0x40 ? FLAG_NEW : 0) | (code & 0x20 ? FLAG_ERROR : 0) | (code & 0x10 ? FLAG_INVALID : 0);
+        } else if (code == STALE) {
+          flags = 0;
+        } else {
+          int delta = (code & 0x20) ? int(code & 0x3F) - 64 : int(code & 0x3F);
+          last[s] = uint16_t((last[s] + delta) & 0x0FFF);
+          flags = FLAG_NEW;
+        }
+        if (time >= from && time <= to) {
+          printf("%llu,%d,%u,%u\n", (unsigned long long)time, s, last[s], flags);
+        }
+      }
+    }
+  }
+
+  const uint8_t*     data = nullptr;
+  size_t             size = 0;
+  size_t             blockSize = 0;
+  std::vector<Block> blocks;
+};
+
+}
+
+int main(int argc, char** argv){
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s capture.bin [from_us [to_us]]\n", argv[0]);
+    return 2;
+  }
+  Log log;
+  if (!log.open(argv[1])) {
+    fprintf(stderr, "%s: not an A1335 log\n", argv[1]);
+    return 1;
+  }
+  uint64_t from = argc > 2 ? strtoull(argv[2], nullptr, 10) : 0;
+  uint64_t to   = argc > 3 ? strtoull(argv[3], nullptr, 10) : UINT64_MAX;
+  printf("time_us,sensor,angle,flags\n");
+  log.dump(from, to);
+  fprintf(stderr, "%zu blocks\n", log.blockCount());
+  return 0;
+}
@@ -0,0 +1,1006 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Host test against A1335Sim: start, burst reads, the poller,
+  the injected faults and the modules on top of them, from the
+  bus and the buffers to the log and the calibrator. Exits
+  with the number of failures.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335.h"
+#include "A1335Sim.h"
+#include "A1335Bus.h"
+#include "A1335Poller.h"
+#include "A1335Filter.h"
+#include "A1335Stream.h"
+#include "A1335Tracker.h"
+#include "A1335Log.h"
+#include "A1335Frame.h"
+#include "A1335Calibrator.h"
+#include <cstdio>
+#include <cmath>
+#include <atomic>
+#include <thread>
+
+using namespace A1335Reg;
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+      printf("%s:%d: %s failed\n", __FILE__, __LINE__, #condition); \
+      failures++; \
+    } \
+  } while (0)
+
+static void testStart(){
+  A1335Sim sim(0x0C);
+  sim.setExtended(ORATE, ORATE_RATE::set(0xABCD0000, 2));
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  CHECK(sensor.getOutputRate() == 2);
+  CHECK(sensor.start(0x0D) != 0);       // nobody there
+}
+
+static void testOrateTimeout(){          // no shadow copy of ORATE without a successful read
+  A1335Sim sim(0x0C);
+  sim.setExtended(ORATE, 0xABCD0002);
+  sim.setFaults(A1335_SIM_TIMEOUT, 0xFFFF);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 5);
+  CHECK(sensor.setOutputRate(3) != 0);
+  CHECK(sim.getExtended(ORATE) == 0xABCD0002);
+  sim.setFaults(0, 0);
+  CHECK(sensor.setOutputRate(3) == 0);
+  CHECK(sim.getExtended(ORATE) == 0xABCD0003);
+  CHECK(sensor.readOutputRate() == 3);
+}
+
+static void testSaveSettings(){
+  A1335Sim sim(0x0C);
+  sim.setExtended(ORATE, 0xABCD0002);
+  sim.setFaults(A1335_SIM_TIMEOUT, 0xFFFF);
+  A1335 sensor(sim);
+  sensor.start(0x0C);
+  A1335Settings settings;
+  CHECK(!sensor.saveSettings(settings));
+  CHECK(!settings.valid());
+  sim.setFaults(0, 0);
+  CHECK(sensor.saveSettings(settings));
+  CHECK(settings.valid());
+  CHECK(settings.orate == 0xABCD0002);
+  A1335 warm(sim);
+  CHECK(warm.start(0x0C, &settings) == 0);
+  CHECK(warm.getOutputRate() == 2);
+}
+
+static void testReadAll(){
+  A1335Sim sim(0x0C);
+  sim.useVirtualClock(true);
+  sim.setAngle(1000);
+  sim.setTemperature(2400);
+  sim.setField(500);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  sim.advance(1000);
+  A1335Snapshot snap;
+  CHECK(sensor.readAll(snap) == 0);
+  CHECK(snap.parityOk);
+  CHECK(snap.newAngle);
+  CHECK(snap.angle == 1000);
+  CHECK(snap.temp == 2400);
+  CHECK(snap.field == 500);
+  CHECK(snap.status == A1335_STATUS_NEW);
+  CHECK(sensor.readAll(snap) == 0);
+  CHECK(!snap.newAngle);                // no update in between
+}
+
+static void testBus(){
+  A1335Sim simA(0x0C, 1), simB(0x0D, 2);
+  simA.useVirtualClock(true);
+  simB.useVirtualClock(true);
+  simA.setAngle(100);
+  simB.setAngle(200);
+  A1335 a(simA), b(simB);
+  CHECK(a.start(0x0C) == 0);
+  CHECK(b.start(0x0D) == 0);
+  A1335Bus bus;
+  CHECK(bus.sensor(0) == nullptr);
+  CHECK(bus.add(a) == 0);
+  CHECK(bus.add(b) == 1);
+  CHECK(bus.sensor(1) == &b);
+  CHECK(bus.sensor(2) == nullptr);
+  simA.advance(1000);
+  simB.advance(1000);
+  CHECK(bus.update() == 2);
+  const A1335Sample* s = bus.samples();
+  for (byte i = 0; i < 2; i++){
+    CHECK(s[i].flags == A1335_STATUS_NEW);
+    CHECK(s[i].angle == (s[i].sensor ? 200 : 100));
+  }
+}
+
+static void testPoller(){                 // the poller learns the sensor period from micros()
+  hostVirtualClock(true);
+  A1335Sim sim(0x0C);
+  sim.setSpeed(4096);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  A1335Poller poller(sensor);
+  poller.begin();
+  uint32_t expected = sensor.getSamplePeriod();
+  uint32_t begin = micros();
+  uint32_t fresh = 0;
+  A1335Sample sample;
+  while (micros() - begin < 200000) {
+    if (poller.update(sample)) {
+      fresh++;
+    }
+  }
+  uint32_t produced = sim.updates();
+  CHECK(fresh > 0);
+  CHECK(fresh <= produced);
+  CHECK(fresh * 10 >= produced * 9);    // at most one angle in ten missed
+  CHECK(poller.period() + expected / 8 >= expected && poller.period() <= expected + expected / 8);
+  CHECK(poller.staleReads() < poller.reads());
+  hostVirtualClock(false);
+}
+
+static void testTrigger(){
+  A1335Sim sim(0x0C);
+  sim.useVirtualClock(true);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  A1335Poller poller(sensor);
+  poller.begin();
+  poller.useTrigger(true);
+  sim.advance(1000);
+  A1335Sample sample;
+  CHECK(!poller.update(sample));
+  CHECK(poller.reads() == 0);           // nothing is read without a trigger
+  poller.trigger();
+  CHECK(poller.update(sample));
+  CHECK(poller.reads() == 1);
+  CHECK(!poller.update(sample));        // the trigger was used up
+  CHECK(poller.reads() == 1);
+}
+
+static void testFaults(){
+  A1335Sim sim(0x0C, 7);
+  sim.useVirtualClock(true);
+  sim.setSpeed(4096);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+
+  sim.setFaults(A1335_SIM_NACK, 0xFFFF);
+  A1335Result result = sensor.readAngleResult();
+  CHECK(!result.ok());
+  CHECK(result.status & A1335_STATUS_NACK);
+
+  sim.setFaults(A1335_SIM_SHORT, 0xFFFF);
+  A1335Snapshot snap;
+  CHECK(sensor.readAll(snap) == A1335_SHORT_READ);
+
+  sim.setFaults(A1335_SIM_PARITY, 0xFFFF);
+  sim.advance(1000);
+  result = sensor.readAngleResult();
+  CHECK(result.status & A1335_STATUS_PARITY);
+  CHECK(!result.ok());
+
+  sim.setFaults(A1335_SIM_TIMEOUT, 0xFFFF);
+  uint32_t value;
+  CHECK(sensor.extendedRead(ORATE, value) == 5);
+
+  sim.setFaults(A1335_SIM_ERROR, 0xFFFF);
+  sim.advance(1000);
+  CHECK(sensor.readAll(snap) == 0);
+  CHECK(snap.errorFlag);
+  CHECK(snap.status & A1335_STATUS_ERROR);
+  sim.setFaults(0, 0);
+  CHECK(sensor.clearFaults() == 0);
+  sim.advance(1000);
+  CHECK(sensor.readAll(snap) == 0);
+  CHECK(!snap.errorFlag);
+
+  sim.setFaults(A1335_SIM_NACK | A1335_SIM_SHORT | A1335_SIM_PARITY, 6000);
+  uint32_t bad = 0;
+  for (int i = 0; i < 1000; i++){
+    sim.advance(50);
+    if (!sensor.readAngleResult().ok()) {
+      bad++;
+    }
+  }
+  CHECK(bad > 0 && bad < 1000);
+  CHECK(sim.faults() >= bad);
+}
+
+class StuckSim : public A1335Sim {        // takes CTRL writes but never goes idle
+public:
+  byte write(byte address_, byte reg, const byte* data, byte length) override {
+    byte error = A1335Sim::write(address_, reg, data, length);
+    setRegister(STA, uint16_t(getRegister(STA) | 0x0001));  // still in phase 1
+    return error;
+  }
+};
+
+static void testConfigureIdleTimeout(){   // a failed idle still ends with run
+  StuckSim sim;
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  CHECK(sensor.setOutputRate(4) == 5);
+  CHECK(sim.getRegister(CTRL) == CTRL_RUN);
+}
+
+class EfFlipSim : public A1335Sim {       // sets EF of the angle on the wire, which breaks its parity
+public:
+  bool flip = false;
+  byte receive(byte address_, byte* data, byte length) override {
+    byte start = pointer;
+    byte error = A1335Sim::receive(address_, data, length);
+    if (flip && start == ANG) {
+      data[0] |= 0x40;
+    }
+    return error;
+  }
+};
+
+static void testParityIgnoresEf(){        // a corrupted EF bit must not start fault reads
+  EfFlipSim sim;
+  sim.useVirtualClock(true);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  sim.advance(1000);
+  uint32_t before = sim.transfers;
+  sensor.readAngleResult();
+  uint32_t clean = sim.transfers - before;
+  sim.flip = true;
+  sim.advance(1000);
+  before = sim.transfers;
+  A1335Result result = sensor.readAngleResult();
+  CHECK(result.status & A1335_STATUS_PARITY);
+  CHECK(sim.transfers - before == clean);
+  A1335Sample sample;
+  before = sim.transfers;
+  sensor.readSample(sample);
+  CHECK(sample.flags & A1335_STATUS_PARITY);
+  CHECK(sim.transfers - before == clean);
+  CHECK(sensor.faults() == 0);
+}
+
+static void testCic(){                    // decimation by more than 2^7 needs a wide phase counter
+  A1335Cic cic(1, 8);
+  uint16_t out;
+  int outputs = 0;
+  for (int i = 0; i < 2000; i++){
+    if (cic.update(uint16_t(i), out)) {
+      outputs++;
+    }
+  }
+  CHECK(outputs == 2000 / 256);
+}
+
+static void testLatest(){
+  A1335Latest latest;
+  A1335Sample sample = {};
+  CHECK(!latest.load(sample));          // nothing stored yet
+  for (uint16_t i = 1; i <= 300; i++){  // the sequence wraps without hitting "never written"
+    A1335Sample in = { i, uint16_t(i & 0x0FFF), 1, A1335_STATUS_NEW };
+    latest.store(in);
+  }
+  CHECK(latest.load(sample));
+  CHECK(sample.time == 300 && sample.angle == 300 && sample.sensor == 1);
+}
+
+static void testCicValues(){              // settled output from the first one on, also across the 32 bit wrap
+  for (byte order = 1; order <= 3; order++){
+    A1335Cic cic(order, 2);
+    uint16_t out;
+    int outputs = 0;
+    bool exact = true;
+    for (int i = 0; i < 40; i++){
+      if (cic.update(4093, out)) {
+        outputs++;
+        exact = exact && out == 4093;
+      }
+    }
+    CHECK(exact);
+    CHECK(outputs == 10 - (order - 1));
+  }
+
+  A1335Cic cic(2, 2);                     // 2000 counts per sample: the unwrapped angle passes 2^31 after ~1.1 M samples
+  uint16_t out, previous = 0;
+  bool first = true, steady = true;
+  uint32_t outputs = 0;
+  for (uint32_t i = 0; i < 3000000; i++){
+    if (cic.update(uint16_t(i * 2000) & 0x0FFF, out)) {
+      if (!first) {
+        steady = steady && uint16_t(out - previous) % 4096 == (4 * 2000) % 4096;
+      }
+      previous = out;
+      first = false;
+      outputs++;
+    }
+  }
+  CHECK(steady);
+  CHECK(outputs == 3000000 / 4 - 1);
+}
+
+static void testAsyncParity(){           // a corrupted angle is not a valid 0
+  A1335Sim sim(0x0C, 5);
+  sim.useVirtualClock(true);
+  sim.setSpeed(4096);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+
+  sim.setFaults(A1335_SIM_PARITY, 0xFFFF);
+  sim.advance(1000);
+  CHECK(sensor.beginReadAngle() == 0);
+  while (!sensor.poll()) {}
+  CHECK(sensor.asyncResult() == 0);
+  CHECK(sensor.asyncError() == 0);
+  CHECK(sensor.asyncStatus() & A1335_STATUS_PARITY);
+
+  sim.setFaults(A1335_SIM_NACK, 0xFFFF);
+  if (sensor.beginReadAngle() == 0) {
+    while (!sensor.poll()) {}
+  }
+  CHECK(sensor.asyncStatus() & A1335_STATUS_BUS);
+
+  sim.setFaults(0, 0);
+  sim.advance(1000);
+  CHECK(sensor.beginReadAngle() == 0);
+  while (!sensor.poll()) {}
+  CHECK(sensor.asyncError() == 0);
+  CHECK(!(sensor.asyncStatus() & A1335_STATUS_INVALID));
+  CHECK(sensor.asyncStatus() & A1335_STATUS_NEW);
+}
+
+class SimLine : public A1335Transport {  // several simulated sensors on one bus
+public:
+  A1335Sim* sims[4];
+  byte      count = 0;
+  uint32_t  probes[128] = {};
+
+  A1335Sim* at(byte address){
+    for (byte i = 0; i < count; i++){
+      if (sims[i]->probe(address) == 0) {
+        return sims[i];
+      }
+    }
+    return nullptr;
+  }
+  byte probe(byte address) override {
+    probes[address & 0x7F]++;
+    return at(address) ? 0 : 2;
+  }
+  byte write(byte address, byte reg, const byte* data, byte length) override {
+    A1335Sim* sim = at(address);
+    return sim ? sim->write(address, reg, data, length) : 2;
+  }
+  byte select(byte address, byte reg) override {
+    A1335Sim* sim = at(address);
+    return sim ? sim->select(address, reg) : 2;
+  }
+  byte receive(byte address, byte* data, byte length) override {
+    A1335Sim* sim = at(address);
+    return sim ? sim->receive(address, data, length) : 2;
+  }
+};
+
+static void testScan(){                  // reports sensors that do not start, stops when the bus is full
+  A1335Sim simC(0x0C, 1), simD(0x0D, 2), simE(0x0E, 3), simF(0x0F, 4);
+  A1335Sim* sims[4] = { &simC, &simD, &simE, &simF };
+  SimLine line;
+  for (byte i = 0; i < 4; i++){
+    sims[i]->useVirtualClock(true);
+    line.sims[line.count++] = sims[i];
+  }
+  simD.setFaults(A1335_SIM_TIMEOUT, 0xFFFF);  // answers, but ORATE never arrives
+
+  A1335 sensors[4];
+  A1335Bus open;
+  CHECK(open.scan(line, sensors, 4) == 3);
+  CHECK(open.scanFailures() == 1);
+  CHECK(line.probes[0x0D] == 2);        // tried twice
+
+  A1335 fillers[A1335_BUS_MAX_SENSORS - 2];
+  A1335Bus bus;
+  for (byte i = 0; i < A1335_BUS_MAX_SENSORS - 2; i++){
+    bus.add(fillers[i]);
+  }
+  for (byte i = 0; i < 128; i++){
+    line.probes[i] = 0;
+  }
+  const byte extra[1] = { 0x20 };
+  CHECK(bus.scan(line, sensors, 4, extra, 1) == 2);  // 0x0C and 0x0E, 0x0D fails
+  CHECK(bus.sensorCount() == A1335_BUS_MAX_SENSORS);
+  CHECK(bus.scanFailures() == 1);
+  CHECK(line.probes[0x0F] == 0);
+  CHECK(line.probes[0x20] == 0);
+}
+
+static void testTracker(){               // unwraps both ways, learns the speed and bridges dropped samples
+  A1335Tracker tracker;
+  const int32_t speed = 8192;           // 2 turns/s
+  uint32_t t0 = 0xFFFFFFFF - 500000;    // micros() wraps half way
+  int64_t truth = 1000;
+  uint32_t time = t0;
+  for (uint32_t i = 0; i < 1000; i++){
+    truth = 1000 + int64_t(speed) * (time - t0) / 1000000;
+    CHECK(tracker.update(uint16_t(truth & 4095), time));
+    time += 1000;
+  }
+  CHECK(tracker.position() == truth);
+  CHECK(tracker.turns() == int32_t(truth >> 12));
+  CHECK(tracker.velocity() > speed * 98 / 100 && tracker.velocity() < speed * 102 / 100);
+  CHECK(tracker.samples() == 1000);
+
+  time -= 1000;
+  CHECK(!tracker.update(uint16_t(truth & 4095), time));  // same timestamp
+  A1335Sample bad = { time + 1000, 0, 0, A1335_STATUS_NEW | A1335_STATUS_PARITY };
+  CHECK(!tracker.update(bad));
+  CHECK(tracker.samples() == 1000);
+
+  time += 300000;                       // 0.3 s or 0.6 turns without a sample
+  truth += int64_t(speed) * 300000 / 1000000;
+  CHECK(tracker.update(uint16_t(truth & 4095), time));
+  CHECK(tracker.position() == truth);
+
+  tracker.reset();                      // backwards through zero
+  truth = 100;
+  time = 0;
+  for (uint32_t i = 0; i < 500; i++){
+    truth = 100 - int64_t(speed) * time / 1000000;
+    CHECK(tracker.update(uint16_t(truth & 4095), time));
+    time += 1000;
+  }
+  CHECK(tracker.position() == truth);
+  CHECK(tracker.turns() < 0);
+  CHECK(tracker.velocity() < -speed * 98 / 100 && tracker.velocity() > -speed * 102 / 100);
+}
+
+static void testTrackerSim(){            // end to end on the virtual clock
+  hostVirtualClock(true);
+  A1335Sim sim(0x0C, 11);
+  sim.setAngle(2048);
+  sim.setSpeed(-4096);                  // one turn backwards per second
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  A1335Tracker tracker;
+  uint32_t begin = micros();
+  A1335Sample sample;
+  while (micros() - begin < 1000000) {
+    sensor.readSample(sample);
+    tracker.update(sample);
+    delay(1);
+  }
+  CHECK(tracker.samples() > 500);
+  CHECK(tracker.velocity() > -4096 * 103 / 100 && tracker.velocity() < -4096 * 97 / 100);
+  CHECK(tracker.turns() == -1);
+  hostVirtualClock(false);
+}
+
+#ifdef A1335_LOG_DECODE
+class FilePrint : public Print {         // a Print that ends up in a file
+public:
+  FILE*     file;
+  FilePrint(FILE* file_) : file(file_) {}
+  size_t    write(uint8_t c) override { return fwrite(&c, 1, 1, file); }
+  size_t    write(const uint8_t* data, size_t n) override { return fwrite(data, 1, n, file); }
+};
+
+struct LogLine {
+  uint32_t  time;
+  int       sensor;
+  unsigned  a, b;                       // angle and flags, or temp and field
+  bool      side;
+};
+
+static void testLogRoundTrip(){          // A1335LogWriter -> file -> extras/A1335LogDecode gives the samples back
+  const char* path = "A1335SimTest.log";
+  FILE* file = fopen(path, "wb");
+  CHECK(file != nullptr);
+  if (!file) {
+    return;
+  }
+  FilePrint print(file);
+  A1335LogWriter writer(print, 3, 64, 50);  // small blocks, so many headers and forced block changes
+
+  static LogLine expected[4000];
+  int nExpected = 0;
+  uint32_t seed = 12345;
+  uint32_t time = 0xFFFFFFFF - 100000;  // the 32 bit time wraps in the log
+  uint16_t angle[3] = { 0, 2000, 4095 };
+  for (int c = 0; c < 1000; c++){
+    seed = seed * 1103515245 + 12345;
+    uint32_t r = seed >> 8;
+    time += r % 7 == 0 ? 70000 + r % 1000 : r % 5 == 0 ? 1000 + r % 3000 : 100 + r % 100;  // 8, 16 and 32 bit dt
+    A1335Sample samples[3];
+    byte n = 0;
+    for (byte s = 0; s < 3; s++){
+      if ((r >> (s + 4)) % 6 == 0) {
+        continue;                       // sensor not due in this cycle
+      }
+      seed = seed * 1103515245 + 12345;
+      uint32_t q = seed >> 8;
+      byte flags = A1335_STATUS_NEW;
+      if (q % 11 == 0) {
+        flags = 0;                      // stale
+      } else if (q % 13 == 0) {
+        angle[s] = (angle[s] + q) & 0x0FFF;   // a jump
+      } else if (q % 17 == 0) {
+        flags |= A1335_STATUS_PARITY;
+      } else if (q % 19 == 0) {
+        flags = A1335_STATUS_NEW | A1335_STATUS_ERROR;
+      } else {
+        angle[s] = (angle[s] + q % 64 - 32) & 0x0FFF;
+      }
+      samples[n++] = { time, angle[s], s, flags };
+      expected[nExpected++] = { time, s, angle[s], unsigned((flags & (A1335_STATUS_NEW | A1335_STATUS_ERROR)) |
+                                                            (flags & A1335_STATUS_INVALID ? 4 : 0)), false };
+    }
+    writer.cycle(samples, n);
+    if (n && writer.sideDue()) {
+      writer.side(1, 300 + c, 500 + c);
+      expected[nExpected++] = { time, 1, unsigned(300 + c), unsigned(500 + c), true };
+    }
+  }
+  writer.flush();
+  fclose(file);
+  CHECK(writer.bytes() == writer.blocks() * 64);
+
+  FILE* decoded = popen(A1335_LOG_DECODE " A1335SimTest.log 2>/dev/null", "r");
+  CHECK(decoded != nullptr);
+  if (!decoded) {
+    return;
+  }
+  char line[100];
+  int nRead = 0;
+  int wrong = 0;
+  CHECK(fgets(line, sizeof(line), decoded) != nullptr);   // column names
+  while (fgets(line, sizeof(line), decoded)) {
+    unsigned long long t;
+    int sensor;
+    unsigned a, b;
+    bool side = line[0] == '#';
+    if (sscanf(line + side, "%llu,%d,%u,%u", &t, &sensor, &a, &b) != 4 || nRead >= nExpected) {
+      wrong++;
+      continue;
+    }
+    const LogLine& e = expected[nRead++];
+    if (uint32_t(t) != e.time || sensor != e.sensor || a != e.a || b != e.b || side != e.side) {
+      wrong++;
+    }
+  }
+  CHECK(pclose(decoded) == 0);
+  CHECK(nRead == nExpected && nRead > 2000);
+  CHECK(wrong == 0);
+  remove(path);
+}
+#endif
+
+static byte refCrc4(uint32_t frame){     // (seed * x^16 + frame * x^4) mod (x^4 + x + 1), by long division
+  uint32_t rest = uint32_t(0x0F) << 16 ^ frame << 4;
+  for (int8_t bit = 19; bit >= 4; bit--){
+    if (rest & (uint32_t(1) << bit)) {
+      rest ^= uint32_t(0x13) << (bit - 4);
+    }
+  }
+  return byte(rest);
+}
+
+class SensorSpi : public SPIClass {      // the SPI side of an A1335: each frame answers the command of the frame before
+public:
+  byte      regs[64] = {};
+  uint16_t  next = 0;                   // answer for the next frame
+  uint16_t  command = 0;                // of the current frame, for the CRC check
+  uint16_t  answer = 0;
+  uint32_t  frames = 0;
+  uint32_t  badCommands = 0;            // frames whose CRC from the master was wrong
+  byte      corrupt = 0;                // XORed into the next CRC sent back
+
+  uint16_t  transfer16(uint16_t value) override {
+    command = value;
+    answer  = next;
+    byte reg = (value >> 8) & 0x3F;
+    if (value & 0x8000) {
+      regs[reg] = byte(value);
+      next = 0;
+    } else {
+      reg &= ~1;
+      next = uint16_t(regs[reg] << 8 | regs[reg + 1]);
+    }
+    frames++;
+    return answer;
+  }
+  uint8_t   transfer(uint8_t value) override {
+    if ((value >> 4) != refCrc4(command)) {
+      badCommands++;
+    }
+    byte check = refCrc4(answer) ^ corrupt;
+    corrupt = 0;
+    return byte(check << 4);
+  }
+};
+
+static void testSpiCrc(){                // the shift register gives the CRC of the polynomial division
+  uint32_t wrong = 0;
+  for (uint32_t f = 0; f <= 0xFFFF; f++){
+    if (A1335SPI::crc4(uint16_t(f)) != refCrc4(f)) {
+      wrong++;
+    }
+  }
+  CHECK(wrong == 0);
+  uint32_t missed = 0;
+  for (uint32_t f = 0; f <= 0xFFFF; f += 97){    // every single bit error is caught
+    for (byte bit = 0; bit < 16; bit++){
+      if (A1335SPI::crc4(uint16_t(f)) == A1335SPI::crc4(uint16_t(f ^ (1 << bit)))) {
+        missed++;
+      }
+    }
+  }
+  CHECK(missed == 0);
+}
+
+static void testSpiPipeline(){           // n words take n + 1 frames, each answer comes one frame late
+  SensorSpi spi;
+  for (byte r = 0; r < 64; r++){
+    spi.regs[r] = byte(0x40 + r);
+  }
+  A1335SPI bus(spi, 10);
+  bus.begin();
+  byte data[12];
+  CHECK(bus.read(0x0C, 0x20, data, 12) == 0);
+  CHECK(spi.frames == 7);
+  bool same = true;
+  for (byte i = 0; i < 12; i++){
+    same = same && data[i] == byte(0x60 + i);
+  }
+  CHECK(same);
+
+  spi.frames = 0;
+  CHECK(bus.read(0x0C, 0x23, data, 3) == 0);   // odd start: low byte of 0x22, then 0x24 and 0x25
+  CHECK(spi.frames == 3);
+  CHECK(data[0] == 0x63 && data[1] == 0x64 && data[2] == 0x65);
+  CHECK(bus.receive(0x0C, data, 2) == 0);      // the pointer moved on
+  CHECK(data[0] == 0x66 && data[1] == 0x67);
+
+  const byte values[2] = { 0x12, 0x34 };
+  CHECK(bus.write(0x0C, 0x02, values, 2) == 0);
+  CHECK(spi.regs[0x02] == 0x12 && spi.regs[0x03] == 0x34);
+
+  spi.regs[0x22] = 0x81;                // STA with identifier 1000
+  CHECK(bus.probe(0x0C) == 0);
+  spi.regs[0x22] = 0x01;
+  CHECK(bus.probe(0x0C) != 0);
+  CHECK(bus.crcErrors() == 0);
+}
+
+static void testSpiCrcFrames(){          // with CRC on both sides check every frame
+  SensorSpi spi;
+  spi.regs[0x20] = 0xAB;
+  spi.regs[0x21] = 0xCD;
+  A1335SPI bus(spi, 10);
+  bus.begin();
+  bus.setCrc(true);
+  byte data[2];
+  CHECK(bus.read(0x0C, 0x20, data, 2) == 0);
+  CHECK(data[0] == 0xAB && data[1] == 0xCD);
+  CHECK(spi.badCommands == 0);
+  CHECK(bus.crcErrors() == 0);
+
+  spi.corrupt = 0x04;                   // one answer of the next read arrives with a bad CRC
+  CHECK(bus.read(0x0C, 0x20, data, 2) == 4);
+  CHECK(bus.crcErrors() == 1);
+  CHECK(bus.read(0x0C, 0x20, data, 2) == 0);
+  CHECK(bus.crcErrors() == 1);
+}
+
+static void testFrameColumns(){          // every ANG word, 255 frames per batch, against the bit layout of the datasheet
+  static byte frames[255 * A1335_FRAME_SIZE];
+  uint16_t angle[255], temp[255], field[255];
+  byte status[255];
+  uint32_t wrong = 0;
+  for (uint32_t base = 0; base <= 0xFFFF; base += 255){
+    byte n = 0;
+    for (; n < 255 && base + n <= 0xFFFF; n++){
+      byte* frame = frames + n * A1335_FRAME_SIZE;
+      uint16_t words[6] = { uint16_t(base + n), 0x8000, 0, 0, uint16_t(0xF000 | n * 16), uint16_t(0x5000 | (4095 - n)) };
+      for (byte w = 0; w < 6; w++){
+        frame[2 * w]     = byte(words[w] >> 8);
+        frame[2 * w + 1] = byte(words[w]);
+      }
+    }
+    A1335Frame::decode(frames, n, angle, temp, field, status);
+    for (byte i = 0; i < n; i++){
+      uint16_t ang = uint16_t(base + i);
+      byte expected = (ang & 0x2000 ? A1335_STATUS_NEW : 0) | (ang & 0x4000 ? A1335_STATUS_ERROR : 0) |
+                      (__builtin_parity(ang) ? 0 : A1335_STATUS_PARITY);
+      if (angle[i] != (ang & 0x0FFF) || temp[i] != i * 16 || field[i] != 4095 - i || status[i] != expected) {
+        wrong++;
+      }
+    }
+  }
+  CHECK(wrong == 0);
+
+  byte zero[A1335_FRAME_SIZE] = {};     // what updateFrames() leaves for a failed read
+  A1335Frame::flags(zero, 1, status);
+  CHECK(status[0] & A1335_STATUS_PARITY);
+}
+
+static void testFrameBus(){              // frames of a bus cycle decode to what the sensors hold
+  A1335Sim simA(0x0C, 1), simB(0x0D, 2);
+  simA.useVirtualClock(true);
+  simB.useVirtualClock(true);
+  A1335 a(simA), b(simB);
+  CHECK(a.start(0x0C) == 0);
+  CHECK(b.start(0x0D) == 0);
+  simA.setAngle(1234);
+  simA.setTemperature(2400);
+  simA.setField(700);
+  simB.setAngle(3000);
+  simB.setTemperature(2500);
+  simB.setField(900);
+  simB.setFaults(A1335_SIM_ERROR, 0xFFFF);
+  simA.advance(1000);
+  simB.advance(1000);
+  A1335Bus bus;
+  bus.add(a);
+  bus.add(b);
+  byte frames[2 * A1335_FRAME_SIZE];
+  byte index[2], errors[2];
+  CHECK(bus.updateFrames(frames, nullptr, index, errors) == 2);
+  uint16_t angle[2], temp[2], field[2];
+  byte status[2];
+  A1335Frame::decode(frames, 2, angle, temp, field, status);
+  CHECK(index[0] == 0 && index[1] == 1 && errors[0] == 0 && errors[1] == 0);
+  CHECK(angle[0] == 1234 && temp[0] == 2400 && field[0] == 700 && status[0] == A1335_STATUS_NEW);
+  CHECK(angle[1] == 3000 && temp[1] == 2500 && field[1] == 900);
+  CHECK(status[1] == (A1335_STATUS_NEW | A1335_STATUS_ERROR));
+
+  simB.setFaults(A1335_SIM_NACK, 0xFFFF);
+  CHECK(bus.updateFrames(frames, nullptr, index, errors) == 2);
+  A1335Frame::flags(frames, 2, status);
+  CHECK(errors[1] != 0);
+  CHECK(status[0] == 0);                // read again, not new
+  CHECK(status[1] & A1335_STATUS_PARITY);
+}
+
+static void testRing(){                  // empty, full, partial batches and the index wrap at 256
+  A1335Ring<8> ring;
+  A1335Sample sample = {};
+  CHECK(!ring.pop(sample));
+  CHECK(ring.popBatch(&sample, 1) == 0);
+  CHECK(ring.available() == 0);
+
+  uint32_t pushed = 0, popped = 0;
+  bool ordered = true;
+  for (int round = 0; round < 100; round++){   // 100 * 5 samples take the indices around several times
+    for (int i = 0; i < 5; i++){
+      A1335Sample in = { pushed, uint16_t(pushed & 0x0FFF), 0, A1335_STATUS_NEW };
+      CHECK(ring.push(in));
+      pushed++;
+    }
+    A1335Sample out[3];
+    byte n = ring.popBatch(out, 3);
+    CHECK(n == 3);
+    for (byte i = 0; i < n; i++){
+      ordered = ordered && out[i].time == popped++;
+    }
+    while (ring.pop(sample)) {
+      ordered = ordered && sample.time == popped++;
+    }
+  }
+  CHECK(ordered);
+  CHECK(popped == pushed);
+  CHECK(ring.overflows() == 0);
+
+  for (uint32_t i = 0; i < 8; i++){
+    A1335Sample in = { 1000 + i, 0, 0, A1335_STATUS_NEW };
+    CHECK(ring.push(in));
+  }
+  A1335Sample extra = { 2000, 0, 0, A1335_STATUS_NEW };
+  CHECK(ring.available() == 8);
+  CHECK(!ring.push(extra));             // full: the new sample is dropped, the old ones stay
+  CHECK(!ring.push(extra));
+  CHECK(ring.overflows() == 2);
+  A1335Sample all[10];
+  CHECK(ring.popBatch(all, 10) == 8);
+  CHECK(all[0].time == 1000 && all[7].time == 1007);
+  CHECK(ring.push(extra));
+
+  A1335Sim sim(0x0C);                   // a failed read is pushed, flagged
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  sim.setFaults(A1335_SIM_NACK, 0xFFFF);
+  CHECK(ring.sample(sensor, 3));
+  CHECK(ring.pop(sample) && sample.time == 2000);
+  CHECK(ring.pop(sample) && sample.sensor == 3 && (sample.flags & A1335_STATUS_BUS));
+}
+
+static void testRingThreads(){           // a producer and a consumer thread: nothing lost, doubled or torn
+  static A1335Ring<16> ring;
+  const uint32_t total = 200000;
+  std::atomic<bool> done(false);
+  std::thread producer([&](){
+    for (uint32_t i = 0; i < total; ){
+      A1335Sample in = { i, uint16_t(i & 0x0FFF), byte(i >> 12), byte(i >> 20) };
+      if (ring.push(in)) {
+        i++;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    done = true;
+  });
+  uint32_t next = 0;
+  uint32_t wrong = 0;
+  A1335Sample batch[5];
+  while (next < total) {
+    byte n = ring.popBatch(batch, 5);
+    for (byte i = 0; i < n; i++, next++){
+      const A1335Sample& s = batch[i];
+      if (s.time != next || s.angle != (next & 0x0FFF) || s.sensor != byte(next >> 12) || s.flags != byte(next >> 20)) {
+        wrong++;
+      }
+    }
+    if (!n) {
+      if (done && ring.available() == 0) {
+        break;                          // samples went missing
+      }
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  CHECK(next == total);
+  CHECK(wrong == 0);
+}
+
+static int healthCalls = 0;
+static byte healthEvents = 0;
+
+static void onHealthChange(A1335&, byte events){
+  healthCalls++;
+  healthEvents = events;
+}
+
+static void testHealth(){                // round robin reads, limits and a callback only on changes
+  A1335Sim sim(0x0C, 9);
+  sim.useVirtualClock(true);
+  sim.setTemperature(2400);
+  sim.setField(700);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  sensor.setHealthLimits(500, 2600);
+  sensor.onHealth(onHealthChange);
+  CHECK(sensor.health().valid == 0);
+
+  for (byte i = 0; i < 4; i++){
+    CHECK(sensor.housekeeping() == 0);
+    CHECK(sensor.health().valid == (2 << i) - 1);  // TSEN, FIELD, ERR, XERR in turn
+  }
+  CHECK(sensor.health().temp == 2400 && sensor.health().field == 700);
+  CHECK(sensor.health().events == 0);
+  CHECK(healthCalls == 0);
+
+  sim.setField(300);                    // magnet moves away
+  for (byte i = 0; i < 8; i++){
+    sensor.housekeeping();
+  }
+  CHECK(healthCalls == 1);              // once when it starts, not on every read
+  CHECK(healthEvents == A1335_HEALTH_FIELD_LOW);
+
+  sim.setTemperature(2700);
+  for (byte i = 0; i < 4; i++){
+    sensor.housekeeping();
+  }
+  CHECK(healthCalls == 2);
+  CHECK(healthEvents == (A1335_HEALTH_FIELD_LOW | A1335_HEALTH_OVERTEMP));
+
+  sim.setFaults(A1335_SIM_NACK, 0xFFFF); // a failed read keeps the values and the turn
+  CHECK(sensor.housekeeping() != 0);
+  sim.setFaults(0, 0);
+  sim.setTemperature(2400);
+  sim.setField(700);
+  CHECK(sensor.housekeeping() == 0);    // TSEN again
+  CHECK(sensor.health().temp == 2400);
+  CHECK(healthEvents == A1335_HEALTH_FIELD_LOW);
+  CHECK(sensor.housekeeping() == 0);
+  CHECK(healthCalls == 4);
+  CHECK(healthEvents == 0);
+
+  sim.setFaults(A1335_SIM_ERROR, 0xFFFF);  // readAll() refreshes everything in one transfer
+  sim.advance(1000);
+  A1335Snapshot snap;
+  CHECK(sensor.readAll(snap) == 0);
+  CHECK(sensor.health().events & A1335_HEALTH_ERROR);
+  CHECK(healthEvents & A1335_HEALTH_ERROR);
+  sensor.onHealth(nullptr);
+}
+
+static float staticError(A1335Sim& sim, A1335& sensor){  // RMS of corrected minus true angle over a slow sweep
+  sim.setSpeed(0);
+  float sum = 0;
+  int n = 0;
+  for (uint16_t a = 0; a < 4096; a += 7, n++){
+    sim.setAngle(a);
+    delayMicroseconds(100);
+    int16_t e = int16_t((sensor.readAngleRaw() - a + 2048) & 0x0FFF) - 2048;
+    sum += float(e) * e;
+  }
+  return sqrtf(sum / n);
+}
+
+static void testCalibrator(){            // one revolution at 8 turns/s removes most of an off-axis error
+  hostVirtualClock(true);
+  for (int direction = 1; direction >= -1; direction -= 2){
+    A1335Sim sim(0x0C, 21);
+    sim.setHarmonicError(2, 10);
+    sim.setNoise(1);
+    A1335 sensor(sim);
+    CHECK(sensor.start(0x0C) == 0);
+    float before = staticError(sim, sensor);
+
+    static A1335Sample buffer[1500];
+    A1335Calibrator calibrator(buffer, 1500);
+    A1335CalTable table;
+    CHECK(!calibrator.fit(table));      // nothing captured yet
+    sim.setSpeed(direction * 8 * 4096);
+    uint32_t begin = micros();
+    bool done = false;
+    while (!done && micros() - begin < 1000000) {
+      A1335Sample sample;
+      sensor.readSample(sample);
+      done = calibrator.add(sample);
+      delayMicroseconds(150);
+    }
+    CHECK(done);
+    CHECK(calibrator.count() > 400);    // a few hundred samples for the revolution
+    CHECK(calibrator.fit(table));
+    CHECK(table.valid());
+    CHECK(calibrator.residual() < 1.5f);
+
+    CHECK(sensor.setCalibration(&table));
+    float after = staticError(sim, sensor);
+    CHECK(before > 6.0f);               // 10 counts amplitude, 7.1 RMS
+    CHECK(after < 1.5f);
+    CHECK(after < before / 4);
+    sensor.setCalibration(nullptr);
+  }
+  hostVirtualClock(false);
+}
+
+int main(){
+  testStart();
+  testOrateTimeout();
+  testSaveSettings();
+  testReadAll();
+  testBus();
+  testPoller();
+  testTrigger();
+  testFaults();
+  testConfigureIdleTimeout();
+  testParityIgnoresEf();
+  testCic();
+  testLatest();
+  testCicValues();
+  testAsyncParity();
+  testScan();
+  testTracker();
+  testTrackerSim();
+#ifdef A1335_LOG_DECODE
+  testLogRoundTrip();
+#endif
+  testSpiCrc();
+  testSpiPipeline();
+  testSpiCrcFrames();
+  testFrameColumns();
+  testFrameBus();
+  testRing();
+  testRingThreads();
+  testHealth();
+  testCalibrator();
+  printf("%s: %d failure(s)\n", failures ? "FAIL" : "OK", failures);
+  return failures;
+}
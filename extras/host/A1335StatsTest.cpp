@@ -0,0 +1,196 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Host test of the builds with A1335_INSTRUMENTATION and
+  A1335_TIMESTAMPS against A1335Sim: the counters, the stamps
+  and the profiler. Exits with the number of failures.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "A1335.h"
+#include "A1335Sim.h"
+#include "A1335Stream.h"
+#include "A1335Profiler.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace A1335Reg;
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+      printf("%s:%d: %s failed\n", __FILE__, __LINE__, #condition); \
+      failures++; \
+    } \
+  } while (0)
+
+static void testRawBusErrors(){          // a failed transfer is a bus error, not a bad angle
+  A1335Sim sim(0x0C, 3);
+  sim.useVirtualClock(true);
+  sim.setSpeed(4096);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  sensor.resetStats();
+
+  sim.setFaults(A1335_SIM_NACK, 0xFFFF);
+  CHECK(sensor.readAngleRaw() == 0);
+  sim.setFaults(A1335_SIM_SHORT, 0xFFFF);
+  CHECK(sensor.readAngleRaw() == 0);
+  CHECK(sensor.stats().transfers == 2);
+  CHECK(sensor.stats().nacks == 1);
+  CHECK(sensor.stats().shortReads == 1);
+  CHECK(sensor.stats().angles == 0);
+  CHECK(sensor.stats().parityErrors == 0);
+
+  sim.setFaults(A1335_SIM_PARITY, 0xFFFF);
+  sim.advance(1000);
+  CHECK(sensor.readAngleRaw() == 0);
+  CHECK(sensor.stats().angles == 1);
+  CHECK(sensor.stats().parityErrors == 1);
+
+  sim.setFaults(0, 0);
+  sim.advance(1000);
+  sensor.readAngleRaw();
+  CHECK(sensor.stats().angles == 2);
+  CHECK(sensor.stats().parityErrors == 1);
+}
+
+static void testAsyncCounted(){          // poll() keeps the same books as readAngleRaw()
+  A1335Sim sim(0x0C, 3);
+  sim.useVirtualClock(true);
+  sim.setSpeed(4096);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  sensor.resetStats();
+
+  sim.setFaults(A1335_SIM_PARITY, 0xFFFF);
+  sim.advance(1000);
+  CHECK(sensor.beginReadAngle() == 0);
+  while (!sensor.poll()) {}
+  CHECK(sensor.stats().angles == 1);
+  CHECK(sensor.stats().parityErrors == 1);
+
+  sim.setFaults(0, 0);
+  sim.advance(1000);
+  CHECK(sensor.beginReadAngle() == 0);
+  while (!sensor.poll()) {}
+  CHECK(sensor.stats().angles == 2);
+  CHECK(sensor.stats().parityErrors == 1);
+  CHECK(sensor.stats().stale == 0);
+  CHECK(sensor.stats().transfers >= 2);
+}
+
+class TextPrint : public Print {         // collects what is printed
+public:
+  char      text[2000] = {};
+  size_t    length = 0;
+  size_t    write(uint8_t c) override {
+    if (length + 1 < sizeof(text)) {
+      text[length++] = char(c);
+    }
+    return 1;
+  }
+};
+
+static void testHistogram(){             // log2 bins, mean, max and percentiles
+  A1335Histogram h;
+  CHECK(h.count() == 0 && h.mean() == 0 && h.percentile(50) == 0);
+  const uint32_t values[6] = { 0, 1, 2, 3, 16383, 100000 };
+  const byte     bins[6]   = { 0, 1, 2, 2, 14, 15 };
+  for (byte i = 0; i < 6; i++){
+    h.add(values[i]);
+    CHECK(h.bin(bins[i]) >= 1);
+  }
+  CHECK(h.bin(2) == 2);
+  CHECK(h.count() == 6);
+  CHECK(h.max() == 100000);
+  CHECK(h.mean() == (0 + 1 + 2 + 3 + 16383 + 100000) / 6);
+
+  h.reset();
+  for (byte i = 0; i < 90; i++){
+    h.add(5);                            // bin 3: 4..7 us
+  }
+  for (byte i = 0; i < 10; i++){
+    h.add(1000);                         // bin 10: 512..1023 us
+  }
+  CHECK(h.percentile(50) == 7);
+  CHECK(h.percentile(90) == 7);
+  CHECK(h.percentile(91) == 1000);      // capped by the longest duration
+  CHECK(h.percentile(100) == 1000);
+  CHECK(h.mean() == (90 * 5 + 10 * 1000) / 100);
+}
+
+static void testProfilerStages(){        // each stage between its two stamps, per sensor and per bus
+  A1335Profiler<2, 2> profiler;
+  A1335Sample sample = {};
+  sample.time    = 180;
+  sample.sensor  = 1;
+  sample.stamps  = { 100, 150, 185, 190, 400 };
+  profiler.add(sample, 1);
+  const uint32_t expected[A1335_STAGES] = { 50, 30, 5, 210, 300 };
+  for (byte k = 0; k < A1335_STAGES; k++){
+    CHECK(profiler.sensor(1, A1335Stage(k)).count() == 1);
+    CHECK(profiler.sensor(1, A1335Stage(k)).max() == expected[k]);
+    CHECK(profiler.bus(1, A1335Stage(k)).max() == expected[k]);
+    CHECK(profiler.sensor(0, A1335Stage(k)).count() == 0);
+    CHECK(profiler.bus(0, A1335Stage(k)).count() == 0);
+  }
+
+  sample.stamps = { 0, 150, 185, 0, 0 };   // no poller, no queue: age runs from request to decoded
+  profiler.add(sample, 1);
+  CHECK(profiler.sensor(1, A1335_STAGE_WAIT).count() == 1);
+  CHECK(profiler.sensor(1, A1335_STAGE_QUEUE).count() == 1);
+  CHECK(profiler.sensor(1, A1335_STAGE_AGE).count() == 2);
+  CHECK(profiler.sensor(1, A1335_STAGE_AGE).bin(6) == 1);   // 35 us
+
+  sample.stamps = { 160, 150, 185, 0, 0 }; // estimated update after the request counts as 0
+  profiler.add(sample, 1);
+  CHECK(profiler.sensor(1, A1335_STAGE_WAIT).bin(0) == 1);
+
+  sample.sensor = 5;                    // out of range, ignored
+  profiler.add(sample, 0);
+  CHECK(profiler.bus(0, A1335_STAGE_BUS).count() == 0);
+
+  TextPrint out;
+  profiler.print(out);
+  CHECK(strstr(out.text, "sensor 1 bus: n=3 mean=30 ") != nullptr);
+  CHECK(strstr(out.text, "bus 1 queue: n=1 mean=210 ") != nullptr);
+  CHECK(strstr(out.text, "sensor 0") == nullptr);
+  profiler.reset();
+  CHECK(profiler.sensor(1, A1335_STAGE_AGE).count() == 0);
+}
+
+static void testProfilerRing(){          // stamps of the real read path on the virtual clock
+  hostVirtualClock(true);
+  A1335Sim sim(0x0C, 4);
+  sim.setSpeed(4096);
+  A1335 sensor(sim);
+  CHECK(sensor.start(0x0C) == 0);
+  A1335Ring<8> ring;
+  A1335Profiler<1> profiler;
+  for (byte i = 0; i < 20; i++){
+    CHECK(ring.sample(sensor));
+    delay(1);
+    A1335Sample sample;
+    CHECK(ring.pop(sample));
+    CHECK(sample.stamps.request && sample.stamps.decoded && sample.stamps.pushed && sample.stamps.popped);
+    CHECK(sample.stamps.popped - sample.stamps.pushed >= 1000);
+    profiler.add(sample);
+  }
+  CHECK(profiler.sensor(0, A1335_STAGE_BUS).count() == 20);
+  CHECK(profiler.sensor(0, A1335_STAGE_WAIT).count() == 0);
+  CHECK(profiler.sensor(0, A1335_STAGE_QUEUE).mean() >= 1000);
+  CHECK(profiler.sensor(0, A1335_STAGE_AGE).mean() > profiler.sensor(0, A1335_STAGE_QUEUE).mean());
+  hostVirtualClock(false);
+}
+
+int main(){
+  testRawBusErrors();
+  testAsyncCounted();
+  testHistogram();
+  testProfilerStages();
+  testProfilerRing();
+  printf("%s: %d failure(s)\n", failures ? "FAIL" : "OK", failures);
+  return failures;
+}
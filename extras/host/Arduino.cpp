@@ -0,0 +1,110 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Host shim: clock, pins, Print and the bus objects
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SPI.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdarg>
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+static bool     virtualClock = false;
+static uint32_t virtualTime = 0;
+
+static uint32_t realMicros(){
+  return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+void      hostVirtualClock(bool enable){
+  if (enable && !virtualClock) {
+    virtualTime = realMicros();         // no jump back for timestamps taken before
+  }
+  virtualClock = enable;
+}
+
+uint32_t  micros(){
+  return virtualClock ? virtualTime++ : realMicros();
+}
+
+uint32_t  millis(){
+  return micros() / 1000;
+}
+
+uint32_t  hostNanos(){
+  return uint32_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+void      delay(uint32_t ms){
+  delayMicroseconds(ms * 1000);
+}
+
+void      delayMicroseconds(uint32_t us){
+  if (virtualClock) {
+    virtualTime += us;
+    return;
+  }
+  uint32_t begin = micros();
+  while (micros() - begin < us) {
+  }
+}
+
+void      pinMode(uint8_t, uint8_t){
+}
+
+void      digitalWrite(uint8_t, uint8_t){
+}
+
+int       digitalRead(uint8_t){
+  return LOW;
+}
+
+size_t    Print::write(const uint8_t* data, size_t n){
+  size_t total = 0;
+  while (n--) {
+    total += write(*data++);
+  }
+  return total;
+}
+
+static size_t printTo(Print& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+static size_t printTo(Print& out, const char* format, ...){
+  char text[64];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (n < 0) {
+    return 0;
+  }
+  return out.write(reinterpret_cast<const uint8_t*>(text), size_t(n) < sizeof(text) ? size_t(n) : sizeof(text) - 1);
+}
+
+size_t    Print::print(const char* s)       { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+size_t    Print::print(char c)              { return write(uint8_t(c)); }
+size_t    Print::print(int v)               { return printTo(*this, "%d", v); }
+size_t    Print::print(unsigned int v)      { return printTo(*this, "%u", v); }
+size_t    Print::print(long v)              { return printTo(*this, "%ld", v); }
+size_t    Print::print(unsigned long v)     { return printTo(*this, "%lu", v); }
+size_t    Print::print(double v, int digits){ return printTo(*this, "%.*f", digits, v); }
+size_t    Print::println()                  { return print("\r\n"); }
+size_t    Print::println(const char* s)     { return print(s) + println(); }
+size_t    Print::println(char c)            { return print(c) + println(); }
+size_t    Print::println(int v)             { return print(v) + println(); }
+size_t    Print::println(unsigned int v)    { return print(v) + println(); }
+size_t    Print::println(long v)            { return print(v) + println(); }
+size_t    Print::println(unsigned long v)   { return print(v) + println(); }
+size_t    Print::println(double v, int digits){ return print(v, digits) + println(); }
+
+size_t    HostSerial::write(uint8_t c){
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+HostSerial Serial;
+TwoWire    Wire;
+SPIClass   SPI;
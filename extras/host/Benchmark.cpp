@@ -0,0 +1,19 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Host build of examples/Benchmark against A1335Mock: one round
+  of measurements, for comparing the library overhead between
+  versions.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#define USE_MOCK 1
+#define PAUSE_MS 0
+
+#include "../../examples/Benchmark/Benchmark.ino"
+
+int main(){
+  setup();
+  loop();
+  return 0;
+}
@@ -0,0 +1,36 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Host shim: an SPIClass without devices, MISO reads all ones.
+  Tests derive from it to simulate one.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335_HOST_SPI_H
+#define A1335_HOST_SPI_H
+
+#include "Arduino.h"
+
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+
+class SPISettings {
+public:
+  SPISettings(uint32_t = 4000000, uint8_t = MSBFIRST, uint8_t = SPI_MODE0) {}
+};
+
+class SPIClass {                      // virtual, so a test can put a simulated device behind it
+public:
+  virtual ~SPIClass() {}
+  virtual void      begin() {}
+  virtual void      beginTransaction(const SPISettings&) {}
+  virtual void      endTransaction() {}
+  virtual uint8_t   transfer(uint8_t) { return 0xFF; }
+  virtual uint16_t  transfer16(uint16_t) { return 0xFFFF; }
+};
+
+extern SPIClass SPI;
+
+#endif //A1335_HOST_SPI_H
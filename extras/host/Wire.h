@@ -0,0 +1,28 @@
+/***************************************************
+  Arduino library for the Allegro A1335 Magnetic angle sensor
+  Host shim: a TwoWire without devices, every address NACKs.
+  Tests talk to A1335Mock or A1335Sim instead.
+
+  * by Florian von Bertrab
+ ****************************************************/
+
+#ifndef A1335_HOST_WIRE_H
+#define A1335_HOST_WIRE_H
+
+#include "Arduino.h"
+
+class TwoWire {
+public:
+  void      begin() {}
+  void      setClock(uint32_t) {}
+  void      beginTransmission(uint8_t) {}
+  uint8_t   endTransmission(bool = true) { return 2; }
+  uint8_t   requestFrom(uint8_t, uint8_t) { return 0; }
+  size_t    write(uint8_t) { return 1; }
+  int       available() { return 0; }
+  int       read() { return -1; }
+};
+
+extern TwoWire Wire;
+
+#endif //A1335_HOST_WIRE_H